@@ -19,10 +19,14 @@
 //
 // AVR hardware headers
 //
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
 #include <avr/io.h>
 #include <avr/pgmspace.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 #include <util/setbaud.h>
+#include <util/twi.h>
 
 //
 // Special MACROs defined in <avr/sfr_defs.h> called from <avr/io.h>
@@ -66,9 +70,47 @@ uint16_t data[DATASIZE];
 uint16_t tspan = 0x800; // time span (multiple of unit time)
 uint16_t unit = 1; // delay unit time in ms
 uint8_t tcount = 5; // minimum count to trigger
-uint8_t uunit1 = 5; // delay unit for MCU loop
-uint8_t uunit3 = 15; // delay unit for MCU loop
-uint8_t t_pwm = 3; // PWM duty 50/50
+uint8_t t_pwm = 0x80; // PWM duty 50/50 (x/100)
+volatile uint8_t timer_busy; // TIMERn used by a background job (bit n)
+uint8_t t1_uses; // bumped by every TIMER1 setup (MR timing)
+uint8_t t1_ovf_use; // t1_uses of the last t1_start() (TOIE1 set)
+uint8_t fft_top = 5; // number of FFT bins to report
+/////////////////////////////////////////////////////////////////////////////
+//
+// I/O register mnemonics for @name
+//
+// ioregs.h is generated by make from <avr/io.h> for MCU, sorted by name
+// for the binary search.
+//
+/////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  char name[8];   // register name (upper case)
+  uint16_t addr;  // sram address
+} reg_t;
+
+static const reg_t reg_table[] PROGMEM = {
+#define REG(name, addr) {name, addr},
+#include "ioregs.h"
+#undef REG
+};
+#define N_REG (sizeof(reg_table) / sizeof(reg_t))
+
+// return 0 if not found
+static uint16_t reg_find(char *s) {
+  uint16_t lo = 0, hi = N_REG, m;
+  int c;
+  while (lo < hi) {
+    m = (lo + hi) / 2;
+    c = strcmp_P(s, reg_table[m].name);
+    if (c == 0) return pgm_read_word(&reg_table[m].addr);
+    if (c < 0) {
+      hi = m;
+    } else {
+      lo = m + 1;
+    }
+  }
+  return 0;
+}
 /////////////////////////////////////////////////////////////////////////////
 //
 // Convert string to uint16_t
@@ -86,144 +128,9 @@ static uint16_t str2word(char *s) {
   uint16_t m = 0; // return
   uint16_t n;
   uint8_t f;
+  if (s == NULL) return 0;
   if (*s == '@') {  // mnemonic starting with '@'
-    s++;
-    if (!strncmp_P(s, PSTR("PIN"), 3)) {
-      if (*(s + 3) >= 'A' && *(s + 3) <= 'F') {
-        m = 3 * (*(s + 3) - 'A') + 0x20;
-      } else {
-        m = 0x20; // PINA
-      }
-    } else if (!strncmp_P(s, PSTR("DDR"), 3)) {
-      if (*(s + 3) >= 'A' && *(s + 3) <= 'F') {
-        m = 3 * (*(s + 3) - 'A') + 0x21;
-      } else {
-        m = 0x21; // DDRA
-      }
-    } else if (!strncmp_P(s, PSTR("PORT"), 4)) {
-      if (*(s + 4) >= 'A' && *(s + 4) <= 'F') {
-        m = 3 * (*(s + 4) - 'A') + 0x22;
-      } else {
-        m = 0x22; // PORTA
-      }
-#ifdef VERBOSE
-    } else if (!strncmp_P(s, PSTR("TIFR"), 4)) {
-      if (*(s + 4) >= '0' && *(s + 4) <= '3') {
-        m = 3 * (*(s + 4) - '0') + 0x35;
-      } else {
-        m = 0x35; // TIFR0
-      }
-    } else if (!strcmp_P(s, PSTR("PCIFR"))) {
-      m = 0x3b;
-    } else if (!strcmp_P(s, PSTR("EIFR"))) {
-      m = 0x3c;
-    } else if (!strcmp_P(s, PSTR("EIMSK"))) {
-      m = 0x3d;
-    } else if (!strcmp_P(s, PSTR("GPIR0"))) {
-      m = 0x3e;
-    } else if (!strcmp_P(s, PSTR("EECR"))) {
-      m = 0x3f;
-    } else if (!strcmp_P(s, PSTR("EEDR"))) {
-      m = 0x40;
-    } else if (!strcmp_P(s, PSTR("EEARL"))) {
-      m = 0x41;
-    } else if (!strcmp_P(s, PSTR("EEARH"))) {
-      m = 0x42;
-    } else if (!strcmp_P(s, PSTR("GTCCR"))) {
-      m = 0x43;
-    } else if (!strcmp_P(s, PSTR("TCCR0A"))) {
-      m = 0x44;
-    } else if (!strcmp_P(s, PSTR("TCCR0B"))) {
-      m = 0x45;
-    } else if (!strcmp_P(s, PSTR("TCNT0"))) {
-      m = 0x46;
-    } else if (!strcmp_P(s, PSTR("OCR0A"))) {
-      m = 0x47;
-    } else if (!strcmp_P(s, PSTR("OCR0B"))) {
-      m = 0x48;
-    } else if (!strcmp_P(s, PSTR("PLLCSR"))) {
-      m = 0x49;
-    } else if (!strcmp_P(s, PSTR("GPIOR1"))) {
-      m = 0x4a;
-    } else if (!strcmp_P(s, PSTR("GPIOR2"))) {
-      m = 0x4b;
-    } else if (!strcmp_P(s, PSTR("SPCR"))) {
-      m = 0x4c;
-    } else if (!strcmp_P(s, PSTR("SPSR"))) {
-      m = 0x4d;
-    } else if (!strcmp_P(s, PSTR("SPDR"))) {
-      m = 0x4e;
-    } else if (!strcmp_P(s, PSTR("ACSR"))) {
-      m = 0x50;
-    } else if (!strcmp_P(s, PSTR("OCDR"))) {
-      m = 0x51;
-    } else if (!strcmp_P(s, PSTR("MONDR"))) {
-      m = 0x51;
-    } else if (!strcmp_P(s, PSTR("SMCR"))) {
-      m = 0x53;
-    } else if (!strcmp_P(s, PSTR("MCUSR"))) {
-      m = 0x54;
-    } else if (!strcmp_P(s, PSTR("MCUCR"))) {
-      m = 0x55;
-    } else if (!strcmp_P(s, PSTR("SPMCSR"))) {
-      m = 0x57;
-    } else if (!strcmp_P(s, PSTR("RPMZ"))) {
-      m = 0x5b;
-    } else if (!strcmp_P(s, PSTR("SPL"))) {
-      m = 0x5d;
-    } else if (!strcmp_P(s, PSTR("SPH"))) {
-      m = 0x5e;
-    } else if (!strcmp_P(s, PSTR("SREG"))) {
-      m = 0x5f;
-    } else if (!strcmp_P(s, PSTR("WDTCSR"))) {
-      m = 0x60;
-    } else if (!strcmp_P(s, PSTR("CLKPR"))) {
-      m = 0x61;
-    } else if (!strcmp_P(s, PSTR("PRR0"))) {
-      m = 0x64;
-    } else if (!strcmp_P(s, PSTR("PRR1"))) {
-      m = 0x65;
-    } else if (!strcmp_P(s, PSTR("OSCCAL"))) {
-      m = 0x66;
-    } else if (!strcmp_P(s, PSTR("PCICR"))) {
-      m = 0x68;
-    } else if (!strcmp_P(s, PSTR("EICRA"))) {
-      m = 0x69;
-    } else if (!strcmp_P(s, PSTR("EICRB"))) {
-      m = 0x6a;
-    } else if (!strcmp_P(s, PSTR("PCMSK0"))) {
-      m = 0x6b;
-    } else if (!strncmp_P(s, PSTR("TIMSK"), 5)) {
-      if (*(s + 5) >= '0' && *(s + 5) <= '3') {
-        m = 3 * (*(s + 5) - '0') + 0x6e;
-      } else {
-        m = 0x6e; // TIMSK0
-      }
-    } else if (!strcmp_P(s, PSTR("ADCL"))) {
-      m = 0x78;
-    } else if (!strcmp_P(s, PSTR("ADCH"))) {
-      m = 0x79;
-    } else if (!strcmp_P(s, PSTR("ADCSRA"))) {
-      m = 0x7a;
-    } else if (!strcmp_P(s, PSTR("ADCSRB"))) {
-      m = 0x7b;
-    } else if (!strcmp_P(s, PSTR("ADMUX"))) {
-      m = 0x7c;
-    } else if (!strcmp_P(s, PSTR("DIDR0"))) {
-      m = 0x7e;
-    } else if (!strcmp_P(s, PSTR("DIDR1"))) {
-      m = 0x7f;
-    } else if (!strncmp_P(s, PSTR("TCCR1"), 5)) {
-      if (*(s + 5) >= 'A' && *(s + 5) <= 'C') {
-        m = 3 * (*(s + 5) - 'A') + 0x80;
-      } else {
-        m = 0x80; // TCCR1A
-      }
-      // Give up after 0x84
-#endif  // VERBOSE
-    } else {
-      m = 0;
-    }
+    m = reg_find(s + 1);
   } else { // non-nmemonic = number
     do {
       f = 0;
@@ -258,8 +165,7 @@ static uint16_t str2word(char *s) {
           n |= *s - 'A' + 10;
           s++;
         } else {
-          *s = '\0'; // wacky char to stop
-          break;
+          return m + (f ? -n : n); // wacky char to stop
         }
       }
       m += f ? -n : n; // do add/sub math
@@ -272,11 +178,140 @@ static uint16_t str2word(char *s) {
 // AVR HW monitor and control
 //
 /////////////////////////////////////////////////////////////////////////////
+//
+// Sniffer event log in data[]: data[0] = 0x5e00 | mode (1: I2C, 2: SPI,
+// 3: UART), then one word per event: event << 8 | byte
+//
+#define SNIFF_I2C 1
+#define SNIFF_SPI 2
+#define SNIFF_UART 3
+#define EV_ACK   0x01  // data byte, ACK (SPI, UART: data byte)
+#define EV_NACK  0x02  // data byte, NACK
+#define EV_ADDR  0x03  // address byte, ACK
+#define EV_ADDRN 0x04  // address byte, NACK
+#define EV_START 0x05  // START (repeated START in a transaction)
+#define EV_STOP  0x06  // STOP
+#define EV_CS    0x07  // SS low
+#define EV_CSX   0x08  // SS high
+#define EV_FERR  0x09  // UART byte with framing error
+
+static void sniff_dump(void) {
+  uint16_t i;
+  uint8_t e, v, n = 0;
+  print_sP(PSTR("SNIFF DUMP\n"));
+  for (i = 1; i < DATASIZE; i++) {
+    if (data[i] == 0xffff) break;
+    e = data[i] >> 8;
+    v = data[i];
+    switch (e) {
+      case EV_START:
+        print_sP(n ? PSTR(" Sr") : PSTR("S"));
+        n = 1;
+        break;
+      case EV_STOP:
+      case EV_CSX:
+        print_sP(PSTR(" P\n"));
+        n = 0;
+        break;
+      case EV_CS:
+        print_c('S');
+        n = 1;
+        break;
+      case EV_ADDR:
+      case EV_ADDRN:
+        print_c(' ');
+        print_hex2(v >> 1);
+        print_c((v & 1) ? 'R' : 'W');
+        print_sP((e == EV_ADDR) ? PSTR(" A") : PSTR(" N"));
+        break;
+      case EV_ACK:
+      case EV_NACK:
+      case EV_FERR:
+        print_c(' ');
+        print_hex2(v);
+        if ((data[0] & 0xff) == SNIFF_I2C) {
+          print_sP((e == EV_ACK) ? PSTR(" A") : PSTR(" N"));
+        } else if ((data[0] & 0xff) == SNIFF_UART) {
+          print_c('=');
+          print_ascii(v);
+          if (e == EV_FERR) print_c('!');
+          if (v == '\n' || ++n == 16) {
+            print_crlf();
+            n = 0;
+          }
+        }
+        break;
+    }
+  }
+  if (n) print_crlf();
+  print_sP(PSTR("SNIFF DUMP END\n"));
+}
+
+//
+// Single line sampler record: data[0] = 0x5a00, data[1] = OCR1A (one
+// sample every 2 * (OCR1A + 1) clk), data[2...] = samples, MSB first
+//
+static uint32_t spi_sample_ns(uint16_t ocr) {
+  return (uint32_t)(ocr + 1) * 2000 / (F_CPU / 1000000UL);
+}
+
+// edges and the shortest pulse (in samples) of the data[] samples
+static void spi_sample_stat(void) {
+  uint8_t *buf = (uint8_t *)(data + 2);
+  uint16_t i, edges = 0, run = 0, rmin = 0xffff;
+  uint8_t b, x, x0;
+  x0 = buf[0] >> 7;
+  for (i = 0; i < 2 * (DATASIZE - 2); i++) {
+    for (b = 0x80; b; b >>= 1) {
+      x = (buf[i] & b) ? 1 : 0;
+      if (x != x0) {
+        // the first run is cut by the start of the capture
+        if (edges && run < rmin) rmin = run;
+        edges++;
+        run = 0;
+        x0 = x;
+      }
+      run++;
+    }
+  }
+  print_sP(PSTR("EDGES="));
+  print_hex4(edges);
+  if (rmin != 0xffff) {
+    print_sP(PSTR(" SHORTEST="));
+    print_hex4(rmin);
+    print_sP(PSTR(" samples ("));
+    print_dec(rmin * spi_sample_ns(data[1]));
+    print_sP(PSTR(" ns)"));
+  }
+  print_crlf();
+}
+
+static void spi_sample_dump(void) {
+  uint8_t *buf = (uint8_t *)(data + 2);
+  uint16_t i;
+  uint8_t b;
+  print_sP(PSTR("SAMPLE DUMP ("));
+  print_dec(spi_sample_ns(data[1]));
+  print_sP(PSTR(" ns/sample)\n"));
+  for (i = 0; i < 2 * (DATASIZE - 2); i++) {
+    if ((i & 7) == 0) {
+      print_hex4(i << 3);
+      print_c(':');
+    }
+    if ((i & 1) == 0) print_c(' ');
+    for (b = 0x80; b; b >>= 1) print_c((buf[i] & b) ? '1' : '0');
+    if ((i & 7) == 7) print_crlf();
+  }
+  if (i & 7) print_crlf();
+  spi_sample_stat();
+  print_sP(PSTR("SAMPLE DUMP END\n"));
+}
+
 void data_dump(void) {
   uint16_t i; // data[] pointer
   char *buf1;
   char *buf2;
-  if ((data[0] == 0x0f00) || (data[0] == 0x0f00)) {
+  if ((data[0] == 0x0f00) || (data[0] == 0xf000)) {
     print_sP(PSTR("BIT DUMP "));
     if (data[0] == 0x0f00) {
       print_sP(PSTR("L->H triggered\n"));
@@ -308,11 +343,124 @@ void data_dump(void) {
       print_bin8((uint8_t) data[i], mask[addr_mask]);
       print_crlf();
     }
+  } else if ((data[0] & 0xff00) == 0xac00) {
+    // analog comparator capture: 0xac<start level><clock select>
+    print_sP(PSTR("CAPTURE DUMP (Timer1 ticks, clock select="));
+    print_hex1(data[0]);
+    print_sP(PSTR(")\n"));
+    for (i=1; i < DATASIZE; i ++) {
+      if (data[i] == 0xffff) break;
+      print_hex4(data[i]);
+      print_sP(((i + (data[0] >> 4)) & 1) ? PSTR(" L->H") : PSTR(" H->L"));
+      if (data[i] == 0xfffe) print_sP(PSTR(" (or longer)"));
+      print_crlf();
+    }
+    print_sP(PSTR("CAPTURE DUMP END\n"));
+  } else if (data[0] == 0xbb00) {
+    // bounce events: duration, bounces | flags
+    print_sP(PSTR("BOUNCE DUMP (Timer1 clk/64 ticks, bounces)\n"));
+    for (i=1; i < DATASIZE - 1; i += 2) {
+      if (data[i] == 0xffff) break;
+      print_hex4(data[i]);
+      print_sP(PSTR(" "));
+      print_hex2((uint8_t) data[i + 1]);
+      print_sP((data[i + 1] & 0x100) ? PSTR(" H->L") : PSTR(" L->H"));
+      if (data[i + 1] & 0x200) print_sP(PSTR(" GLITCH"));
+      print_crlf();
+    }
+    print_sP(PSTR("BOUNCE DUMP END\n"));
+  } else if ((data[0] & 0xff00) == 0x5e00) {
+    sniff_dump();
+  } else if (data[0] == 0x5a00) {
+    spi_sample_dump();
   } else {
     print_sP(PSTR("BROKEN BIT/BYTE DUMP DATA\n"));
   }
 }
 
+//
+// Fast GPIO for the BIT pin
+//
+// A toggle is a single store of the bit mask to PINx.  Set and clear go
+// through per-pin functions which compile to a single sbi/cbi, so they are
+// atomic against ISRs.  bit_pin() selects them (gpio_*_any() for the rest).
+//
+static volatile uint8_t *gpio_pinr;   // PINx of the BIT pin
+static volatile uint8_t *gpio_portr;  // PORTx of the BIT pin
+static uint8_t gpio_mask;             // bit mask of the BIT pin
+
+static void gpio_set_any(void) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { *gpio_portr |= gpio_mask; }
+}
+static void gpio_clr_any(void) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { *gpio_portr &= ~gpio_mask; }
+}
+static inline void gpio_tgl(void) { *gpio_pinr = gpio_mask; }
+
+#define GPIO_BIT(p, b)                                         \
+  static void gpio_set_##p##b(void) { PORT##p |= _BV(b); }  \
+  static void gpio_clr_##p##b(void) { PORT##p &= ~_BV(b); }
+#define GPIO_PORT(p)                                      \
+  GPIO_BIT(p, 0) GPIO_BIT(p, 1) GPIO_BIT(p, 2) GPIO_BIT(p, 3) \
+  GPIO_BIT(p, 4) GPIO_BIT(p, 5) GPIO_BIT(p, 6) GPIO_BIT(p, 7)
+#define GPIO_FNS(op, p)                                            \
+  gpio_##op##_##p##0, gpio_##op##_##p##1, gpio_##op##_##p##2,      \
+  gpio_##op##_##p##3, gpio_##op##_##p##4, gpio_##op##_##p##5,      \
+  gpio_##op##_##p##6, gpio_##op##_##p##7
+
+#ifdef BOARD_nano
+GPIO_PORT(B) GPIO_PORT(C) GPIO_PORT(D)
+static void (*const gpio_set_fn[])(void) PROGMEM = {
+  GPIO_FNS(set, B), GPIO_FNS(set, C), GPIO_FNS(set, D)};
+static void (*const gpio_clr_fn[])(void) PROGMEM = {
+  GPIO_FNS(clr, B), GPIO_FNS(clr, C), GPIO_FNS(clr, D)};
+#endif
+#ifdef BOARD_teensy2
+GPIO_PORT(B) GPIO_PORT(C) GPIO_PORT(D) GPIO_PORT(E) GPIO_PORT(F)
+static void (*const gpio_set_fn[])(void) PROGMEM = {
+  GPIO_FNS(set, B), GPIO_FNS(set, C), GPIO_FNS(set, D),
+  GPIO_FNS(set, E), GPIO_FNS(set, F)};
+static void (*const gpio_clr_fn[])(void) PROGMEM = {
+  GPIO_FNS(clr, B), GPIO_FNS(clr, C), GPIO_FNS(clr, D),
+  GPIO_FNS(clr, E), GPIO_FNS(clr, F)};
+#endif
+#ifdef BOARD_teensy2pp
+GPIO_PORT(A) GPIO_PORT(B) GPIO_PORT(C) GPIO_PORT(D) GPIO_PORT(E) GPIO_PORT(F)
+static void (*const gpio_set_fn[])(void) PROGMEM = {
+  GPIO_FNS(set, A), GPIO_FNS(set, B), GPIO_FNS(set, C),
+  GPIO_FNS(set, D), GPIO_FNS(set, E), GPIO_FNS(set, F)};
+static void (*const gpio_clr_fn[])(void) PROGMEM = {
+  GPIO_FNS(clr, A), GPIO_FNS(clr, B), GPIO_FNS(clr, C),
+  GPIO_FNS(clr, D), GPIO_FNS(clr, E), GPIO_FNS(clr, F)};
+#endif
+
+void (*gpio_set)(void) = gpio_set_any;  // BIT pin to 1 (atomic)
+void (*gpio_clr)(void) = gpio_clr_any;  // BIT pin to 0 (atomic)
+
+static void gpio_select(uint8_t port, uint8_t bit) {
+  uint8_t i = port * 8 + bit;
+  gpio_pinr = &_SFR_MEM8(addr_pin);
+  gpio_portr = &_SFR_MEM8(addr_port);
+  gpio_mask = _BV(bit);
+  if (i < sizeof(gpio_set_fn) / sizeof(gpio_set_fn[0])) {
+    gpio_set = (void (*)(void))pgm_read_word(&gpio_set_fn[i]);
+    gpio_clr = (void (*)(void))pgm_read_word(&gpio_clr_fn[i]);
+  } else {
+    gpio_set = gpio_set_any;
+    gpio_clr = gpio_clr_any;
+  }
+}
+
+// select the BIT pin (port index, bit) without changing its mode
+static void bit_pin_at(uint8_t port, uint8_t bit) {
+  addr_pin = _SFR_ADDR(PIN_0) + 3 * port; // PIN address
+  addr_ddr = _SFR_ADDR(DDR_0) + 3 * port; // DDR address
+  addr_port = _SFR_ADDR(PORT_0) + 3 * port; // PORT address
+  addr_mask = port; // mask address (really an index)
+  addr_bit = bit & 0x7; // bit 0-8
+  gpio_select(port, addr_bit); // fast path for bit operations
+}
+
 void bit_pin(char *pin, char *mode) {
   uint16_t port;
   // *pin -> "A6" etc. / initialize with NULL or LED_PIN
@@ -325,11 +473,7 @@ void bit_pin(char *pin, char *mode) {
   if (pin[0] >= PORT_BGN_CH && pin[0] <= PORT_END_CH) {
     port = pin[0] - PORT_BGN_CH;
     if (port < PORT_BGN_CH && port > PORT_END_CH) port = PORT_BGN_CH;
-    addr_pin = _SFR_ADDR(PIN_0) + 3 * port; // PIN address
-    addr_ddr = _SFR_ADDR(DDR_0) + 3 * port; // DDR address
-    addr_port = _SFR_ADDR(PORT_0) + 3 * port; // PORT address
-    addr_mask = port; // mask address (really an index)
-    addr_bit = (pin[1] - '0') & 0x7; // bit 0-8
+    bit_pin_at(port, pin[1] - '0');
     if (!strcmp_P(mode, PSTR("IH")) || !strcmp_P(mode, PSTR("IP"))) {
       _SFR_MEM8(addr_ddr) &= ~_BV(addr_bit); // set for input
       _SFR_MEM8(addr_port) |= _BV(addr_bit); // set for (high) or pull up
@@ -383,10 +527,6 @@ void bit_pin(char *pin, char *mode) {
   }
   print_sP(PSTR(" trigger#="));
   print_hex2(tcount);
-  print_sP(PSTR(" LED#="));
-  print_hex2(uunit1);
-  print_sP(PSTR(","));
-  print_hex2(uunit3);
   print_sP(PSTR(" PWM="));
   print_hex2(t_pwm);
   print_crlf();
@@ -502,11 +642,11 @@ void adps_set(char *para) {
   uint8_t adps;
   if (*para >= '1'  && *para <= '7') {
     adps = (*para - '0') & 0x07;
-    ADMUX &= ~0x07;
-    ADMUX |= adps;
+    ADCSRA &= ~0x07; // ADPS2:0
+    ADCSRA |= adps;
   }
   // report
-  adps = ADMUX & 0x07;
+  adps = ADCSRA & 0x07;
   print_sP(PSTR("Analog prescaler = 2 ^ "));
   print_hex1(adps);
   print_crlf();
@@ -546,17 +686,17 @@ static void analog_off(void) {
 
 void bit_toggle(void) {
   print_sP(PSTR("BIT TOGGLE\n"));
-  _SFR_MEM8(addr_port) ^= _BV(addr_bit);
+  gpio_tgl();
 }
 
 void bit_on(void) {
   print_sP(PSTR("BIT ON\n"));
-  _SFR_MEM8(addr_port) |= _BV(addr_bit);
+  gpio_set();
 }
 
 void bit_off(void) {
   print_sP(PSTR("BIT OFF\n"));
-  _SFR_MEM8(addr_port) &= ~_BV(addr_bit);
+  gpio_clr();
 }
 
 void bit_blink(uint16_t t) {
@@ -564,7 +704,7 @@ void bit_blink(uint16_t t) {
   if (t == 0) t = 5; // default
   print_sP(PSTR("BIT BLINK START\n"));
   do {
-    _SFR_MEM8(addr_port) ^= _BV(addr_bit);
+    gpio_tgl();
     tt = t;
     do {
       _delay_ms(100);
@@ -573,54 +713,176 @@ void bit_blink(uint16_t t) {
   print_sP(PSTR("BIT BLINK END\n"));
 }
 
-static void inline uunit_delay1(void) {
-  for (uint8_t i=uunit1; i>0; i--) {
-    // NOP
-    asm volatile(
-    "       nop\n\t"
-    );
-  }
+//
+// WS2812 transmitter (cycle counted, interrupts disabled)
+//
+// Each bit is sent as 3 stores to PORTx (rise, '0' fall, '1' fall) through
+// Z with the same number of cycles for '0' and '1', so only F_CPU decides
+// the timing.  Target: T0H 375 ns, T1H 750 ns, bit 1250 ns (800 kHz).
+// With 2 cycle stores, 8 MHz gives 375/750/1375 ns which is still within
+// the WS2812/WS2812B tolerance.  Byte boundaries add 6 cycles to TxL.
+//
+#if F_CPU < 8000000UL
+#warning "WS2812 timing needs F_CPU >= 8 MHz"
+#endif
+#define WS_CYC(ns) ((F_CPU / 1000000UL * (ns) + 500) / 1000)
+#define WS_POS(x) (((x) > 0) ? (x) : 0)
+#define WS_A WS_POS((long)WS_CYC(375) - 2)
+#define WS_B WS_POS((long)WS_CYC(750) - 4 - WS_A)
+#define WS_C WS_POS((long)WS_CYC(1250) - 9 - WS_A - WS_B)
+#define WS_NOPS(n) ".rept %[" #n "]\n\tnop\n\t.endr\n\t"
+#define WS_BIT(n)                 \
+  "mov  %[t], %[hi]\n\t"          \
+  "sbrs %[b], " #n "\n\t"         \
+  "mov  %[t], %[lo]\n\t"          \
+  "st   %a[port], %[hi]\n\t"      \
+  WS_NOPS(wa)                     \
+  "st   %a[port], %[t]\n\t"       \
+  WS_NOPS(wb)                     \
+  "st   %a[port], %[lo]\n\t"      \
+  WS_NOPS(wc)
+
+static void ws2812_send(const uint8_t *p, uint16_t n) {
+  volatile uint8_t *port = &_SFR_MEM8(addr_port);
+  uint8_t hi, lo, b, t, sreg;
+  if (n == 0) return;
+  sreg = SREG;
+  cli();
+  hi = *port | _BV(addr_bit);
+  lo = *port & ~_BV(addr_bit);
+  asm volatile(
+    "1:\n\t"
+    "ld   %[b], %a[p]+\n\t"
+    WS_BIT(7) WS_BIT(6) WS_BIT(5) WS_BIT(4)
+    WS_BIT(3) WS_BIT(2) WS_BIT(1) WS_BIT(0)
+    "sbiw %[n], 1\n\t"
+    "brne 1b\n\t"
+    : [b] "=&r"(b), [t] "=&r"(t), [n] "+w"(n), [p] "+x"(p)
+    : [port] "z"(port), [hi] "r"(hi), [lo] "r"(lo),
+      [wa] "n"(WS_A), [wb] "n"(WS_B), [wc] "n"(WS_C)
+    : "memory");
+  SREG = sreg;
 }
-static void inline uunit_delay3(void) {
-  for (uint8_t i=uunit3; i>0; i--) {
-    // NOP
-    asm volatile(
-    "       nop\n\t"
-    );
+
+//
+// LED data buffer: free SRAM between the end of .bss and the stack
+//
+extern char __heap_start;  // end of .bss (linker script)
+uint8_t *pixled;           // G, R, B bytes of each LED
+uint16_t ledmax;           // buffer size (3 * max #LEDs)
+uint16_t ledlen;           // 3 * (#LEDs)
+
+// call from main() only: SP marks the bottom of the main() stack frame
+static void led_init(void) {
+  uint16_t n = SP - (uint16_t)&__heap_start;
+  n = (n > STACK_RESERVE) ? n - STACK_RESERVE : 0;
+  ledmax = n - n % 3;
+  pixled = (uint8_t *)&__heap_start;
+  ledlen = 0;
+}
+
+//
+// WS2812 hardware backend (SPI or USART in SPI mode, interrupt driven)
+//
+// The data line is the serial output clocked at 4 MHz.  Each LED bit is a
+// 4 bit symbol (0: 1000, 1: 1110) of 1 us, so a byte carries 2 LED bits.
+// The ISR adds a few us of low time between bytes, which the WS2812(B)
+// take as a longer bit.  Interrupts stay enabled and the output runs in
+// the background.
+//
+#if defined(PIX_SPI)
+#define PIX_vect SPI_STC_vect
+#define PIX_DATA SPDR
+#define PIX_STOP (SPCR = 0)
+#else
+#define PIX_vect USART1_UDRE_vect
+#define PIX_DATA UDR1
+#define PIX_STOP (UCSR1B &= ~_BV(UDRIE1))
+#endif
+static const uint8_t pix_sym[4] = {0x88, 0x8e, 0xe8, 0xee};
+static const uint8_t *pix_p;     // next LED byte
+static uint16_t pix_n;           // LED bytes left
+static uint8_t pix_b;            // LED byte being sent
+static uint8_t pix_k;            // symbol bytes left of pix_b
+static volatile uint8_t pix_busy;
+uint8_t pix_hw = 0;              // 1: LED data by the hardware backend
+
+ISR(PIX_vect) {
+  if (pix_k == 0) {
+    if (pix_n == 0) {
+      PIX_STOP;
+      pix_busy = 0;
+      return;
+    }
+    pix_b = *pix_p++;
+    pix_n--;
+    pix_k = 4;
   }
+  PIX_DATA = pix_sym[pix_b >> 6];
+  pix_b <<= 2;
+  pix_k--;
 }
 
-static void pixel_0(void) {
-    uunit_delay1();
-    _SFR_MEM8(addr_port) ^= ~_BV(addr_bit);
-    uunit_delay3();
-    _SFR_MEM8(addr_port) |= _BV(addr_bit);
+// wait until the LED buffer is free again
+static void pix_wait(void) {
+  while (pix_busy) ;
 }
 
-static void pixel_1(void) {
-    uunit_delay3();
-    _SFR_MEM8(addr_port) ^= ~_BV(addr_bit);
-    uunit_delay1();
-    _SFR_MEM8(addr_port) |= _BV(addr_bit);
+static void pix_start(const uint8_t *p, uint16_t n) {
+  pix_wait();
+  _delay_us(300); // reset (latch) for WS2812 and WS2812B
+  if (n == 0) return;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    pix_p = p;
+    pix_n = n;
+    pix_k = 0;
+    pix_busy = 1;
+#if defined(PIX_SPI)
+    PORTB &= ~(_BV(PB2) | _BV(PB3) | _BV(PB5));
+    DDRB |= _BV(PB2) | _BV(PB3) | _BV(PB5);  // SS as output keeps master mode
+#if F_CPU > 12000000UL
+    SPSR = 0;                                // clk/4
+#else
+    SPSR = _BV(SPI2X);                       // clk/2
+#endif
+    SPCR = _BV(SPIE) | _BV(SPE) | _BV(MSTR); // MSB first, mode 0
+    SPDR = 0x00;                             // low, ISR follows
+#else
+    PORTD &= ~(_BV(PD3) | _BV(PD5));
+    DDRD |= _BV(PD3) | _BV(PD5);             // XCK1 as output: master
+    UBRR1 = 0;
+    UCSR1C = _BV(UMSEL11) | _BV(UMSEL10);    // MSPIM, MSB first, mode 0
+    UCSR1B = _BV(TXEN1);
+    UBRR1 = F_CPU / (2 * 4000000UL) - 1;
+    UDR1 = 0x00;                             // low
+    UCSR1B |= _BV(UDRIE1);
+#endif
+  }
 }
 
-static void pixel_reset(void) {
-    _SFR_MEM8(addr_port) ^= ~_BV(addr_bit);
-    for (uint16_t i=330; i>0; i--) {
-      uunit_delay3();
-    }
-    _SFR_MEM8(addr_port) |= _BV(addr_bit);
+void bit_pixel_hw(char *val) {
+  if (val != NULL && *val != '\0') {
+    pix_hw = str2byte(val) ? 1 : 0;
+  }
+  print_sP(PSTR("LED OUTPUT: "));
+  if (pix_hw) {
+    print_sP(PSTR(PIX_PINS " (background)\n"));
+  } else {
+    print_sP(PSTR("BIT PIN\n"));
+  }
 }
 
-void bit_pixel_dump(uint8_t xlen, uint8_t *x) {
-  if ( xlen > LEDSIZE) xlen = LEDSIZE;
-  uint8_t xxlen = xlen / 3;
+void bit_pixel_dump(uint16_t xlen, uint8_t *x) {
+  if ( xlen > ledmax) xlen = ledmax;
+  uint16_t xxlen = xlen / 3;
   print_sP(PSTR("LED LENGTH: "));
-  print_hex2(xxlen);
-  print_crlf();
-  for (uint8_t i=0; i < xxlen; i++) {
+  print_hex4(xxlen);
+  print_sP(PSTR(" (max "));
+  print_hex4(ledmax / 3);
+  print_sP(PSTR(")\n"));
+  for (uint16_t i=0; i < xxlen; i++) {
     print_sP(PSTR("LED["));
-    print_hex2(i);
+    print_hex4(i);
     print_sP(PSTR("] = G:"));
     print_hex2((uint8_t) *x++);
     print_sP(PSTR(" R:"));
@@ -631,13 +893,23 @@ void bit_pixel_dump(uint8_t xlen, uint8_t *x) {
   }
 }
 
-uint8_t bit_pixel_set(char * token, uint8_t *x) {
-  uint8_t i = 0;
+uint16_t bit_pixel_set(char * token, uint8_t *x) {
+  uint16_t i = 0;
+  uint8_t n; // bytes to be set
+  pix_wait();
   char buf[3]; // buffer to parse color string 2 chars
   while ((token != NULL) && (*token != '\0')) {
     buf[0] = *token++;
     buf[1] = *token++;
     buf[2] = '\0';
+    if (buf[0] != '.') {
+      n = 1;
+    } else if (buf[1] == 'G' || buf[1] == 'R' || buf[1] == 'B' || buf[1] == 'W') {
+      n = 3;
+    } else {
+      n = 12;
+    }
+    if (i + n > ledmax) break; // buffer full
     if (buf[0] == '.') {
       // G    R    B data
       // 0xff 0x00 0x00 lime
@@ -684,146 +956,736 @@ uint8_t bit_pixel_set(char * token, uint8_t *x) {
         *x++ = (uint8_t) 0xff;
         *x++ = (uint8_t) 0xff;
         *x++ = (uint8_t) 0xff;
-        i = 12;
+        i += 12;
       }
     } else {
       *x++ = (uint8_t) str2byte(buf);
-      i+=2;
+      i++;
     }
   }
   return i;
 }
 
-void bit_pixel(uint8_t xlen, uint8_t *x) {
-  print_sP(PSTR("LED PIXEL OUTPUT START\n"));
-  pixel_reset();
-  for (uint8_t i=xlen; i>0; i--) {
-    ( *x & (uint8_t) 0x80 ) ? pixel_1() : pixel_0();
-    ( *x & (uint8_t) 0x40 ) ? pixel_1() : pixel_0();
-    ( *x & (uint8_t) 0x20 ) ? pixel_1() : pixel_0();
-    ( *x & (uint8_t) 0x10 ) ? pixel_1() : pixel_0();
-    ( *x & (uint8_t) 0x08 ) ? pixel_1() : pixel_0();
-    ( *x & (uint8_t) 0x04 ) ? pixel_1() : pixel_0();
-    ( *x & (uint8_t) 0x02 ) ? pixel_1() : pixel_0();
-    ( *x & (uint8_t) 0x01 ) ? pixel_1() : pixel_0();
+//
+// Repeat the current LED data along n LEDs
+//
+void bit_pixel_fill(uint16_t n) {
+  uint16_t i;
+  pix_wait();
+  n *= 3;
+  if (n > ledmax) n = ledmax;
+  for (i = ledlen; i < n; i++) {
+    pixled[i] = (ledlen < 3) ? 0 : pixled[i - ledlen];
   }
+  ledlen = n;
+}
+
+void bit_pixel(uint16_t xlen, uint8_t *x) {
+  if (pix_hw) {
+    pix_start(x, xlen);
+    print_sP(PSTR("LED PIXEL OUTPUT STARTED (" PIX_PINS ")\n"));
+    return;
+  }
+  print_sP(PSTR("LED PIXEL OUTPUT START\n"));
+  gpio_clr();
+  _delay_us(300); // reset (latch) for WS2812 and WS2812B
+  ws2812_send(x, xlen);
   print_sP(PSTR("LED PIXEL OUTPUT END\n"));
 }
 
-void bit_wave(char *token) {
-  //          pwm  HI  LOW    BRIGHT    TIME
-  // TOKEN     0    4   0     100%      4
-  // TOKEN     1    3   1      75%      4
-  // TOKEN     2    2   1      67%      4
-  // TOKEN     3    1   1      50%      4
-  // TOKEN     4    1   2      33%      5
-  // TOKEN     5    1   3      25%      6
-  // TOKEN     6    1   4      20%      7
-  // TOKEN     7    1   5      18%      8
-  // TOKEN     8    1   6      14%      9
-  // TOKEN     ..
-  // TOKEN    255   1   253
-  uint8_t t_pwm_l; // PWM HIGH period
-  uint8_t t_pwm_h; // PWM LOW period
-  uint8_t t_fact; // PWM duration adjust
-  if (token != NULL && *token != '\0') {
-    t_pwm = str2byte(token); // set low length
-  }
-  if (t_pwm < 4) {
-    t_fact = 4;
-    t_pwm_h = 4 - t_pwm;
+//
+// Timer resources for background jobs
+//
+// TIMER0 paces ISR driven (soft) outputs and the FM gate, TIMER1 doubles
+// as the measurement time base, the pattern generator clock and the LED
+// frame clock, and TIMER1/2/3 output compare pins (OCnx) drive waveforms
+// in hardware.
+// A timer owned by a background job is marked in timer_busy.
+//
+static uint8_t timer_free(uint8_t n) {
+  if (timer_busy & _BV(n)) {
+    print_sP(PSTR("E: TIMER"));
+    print_hex1(n);
+    print_sP(PSTR(" busy with a background job (BWX, TX to stop)\n"));
+    return 0;
+  }
+  return 1;
+}
+
+static void timer_take(uint8_t n) {
+  if (n == 1) t1_uses++;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { timer_busy |= _BV(n); }
+}
+
+static void timer_release(uint8_t n) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { timer_busy &= ~_BV(n); }
+}
+
+typedef struct {
+  char port;      // port name: 'B', 'C', ...
+  uint8_t bit;    // bit 0-7
+  uint8_t timer;  // timer number (1, 3: 16 bit, 2: 8 bit)
+  uint8_t ch;     // channel (0: A, 1: B, 2: C)
+} oc_pin_t;
+
+static const oc_pin_t oc_pins[] PROGMEM = {
+#ifdef BOARD_nano
+  {'B', 1, 1, 0}, {'B', 2, 1, 1}, {'B', 3, 2, 0}, {'D', 3, 2, 1},
+#endif
+#ifdef BOARD_teensy2
+  {'B', 5, 1, 0}, {'B', 6, 1, 1}, {'B', 7, 1, 2}, {'C', 6, 3, 0},
+#endif
+#ifdef BOARD_teensy2pp
+  {'B', 5, 1, 0}, {'B', 6, 1, 1}, {'B', 7, 1, 2}, {'B', 4, 2, 0},
+  {'D', 1, 2, 1}, {'C', 6, 3, 0}, {'C', 5, 3, 1}, {'C', 4, 3, 2},
+#endif
+};
+#define N_OC_PINS (sizeof(oc_pins) / sizeof(oc_pin_t))
+
+// Find OCnx for the BIT pin (index to oc_pins[] or 0xff)
+static uint8_t oc_find(void) {
+  char port = (addr_pin - _SFR_ADDR(PIN_0)) / 3 + PORT_BGN_CH;
+  for (uint8_t i = 0; i < N_OC_PINS; i++) {
+    if (pgm_read_byte(&oc_pins[i].port) == port &&
+        pgm_read_byte(&oc_pins[i].bit) == addr_bit) {
+      return i;
+    }
+  }
+  return 0xff;
+}
+
+// TCCRnA address (TCCRnB, TCNTn, ... follow at fixed offsets)
+static uint16_t timer_base(uint8_t n) {
+  if (n == 1) return _SFR_ADDR(TCCR1A);
+#ifdef TCCR2A
+  if (n == 2) return _SFR_ADDR(TCCR2A);
+#endif
+#ifdef TCCR3A
+  if (n == 3) return _SFR_ADDR(TCCR3A);
+#endif
+  return 0;
+}
+
+// log2 of prescaler for clock select 1, 2, ...
+static const uint8_t cs_shift16[] PROGMEM = {0, 3, 6, 8, 10};  // TIMER0/1/3
+static const uint8_t cs_shift2[] PROGMEM = {0, 3, 5, 6, 7, 8, 10};  // TIMER2
+
+//
+// Pick the fastest clock select (1, ...) which brings a period of ticks CPU
+// cycles down to at most max timer counts, or the slowest one.
+//
+static uint8_t timer_prescale(uint32_t ticks, uint32_t max,
+                              const uint8_t *tbl, uint8_t ncs,
+                              uint8_t *shift) {
+  uint8_t cs;
+  for (cs = 1; cs < ncs; cs++) {
+    *shift = pgm_read_byte(&tbl[cs - 1]);
+    if ((ticks >> *shift) <= max) return cs;
+  }
+  *shift = pgm_read_byte(&tbl[ncs - 1]);
+  return ncs;
+}
+
+// ticks >> shift limited to 1 ... max
+static uint32_t timer_counts(uint32_t ticks, uint8_t shift, uint32_t max) {
+  ticks >>= shift;
+  if (ticks > max) ticks = max;
+  if (ticks < 1) ticks = 1;
+  return ticks;
+}
+//
+// ISR driven soft output on TIMER0 (CTC) for pins without OCnx
+//
+// The pin is toggled through PINx at the end of each phase.  Long phases
+// are split into 256 count chunks so that any phase up to 0xffff counts can
+// be produced with the 8 bit counter.  OCR0A is only rewritten when the
+// chunk length changes, so short constant phases are not disturbed by the
+// ISR latency.
+//
+static volatile uint8_t *soft_pinr;  // PIN register of the soft output pin
+static uint8_t soft_mask;            // bit mask of the soft output pin
+static uint16_t soft_hi;             // high phase (counts)
+static uint16_t soft_lo;             // low phase (counts)
+static volatile uint16_t soft_left;  // remaining counts of this phase
+static volatile uint8_t soft_phase;  // 1: high phase
+
+ISR(TIMER0_COMPA_vect) {
+  uint16_t n;
+  if (soft_left == 0) {
+    *soft_pinr = soft_mask;  // toggle
+    soft_phase ^= 1;
+    soft_left = soft_phase ? soft_hi : soft_lo;
+  }
+  n = (soft_left > 0x100) ? 0x100 : soft_left;
+  if (OCR0A != (uint8_t)(n - 1)) OCR0A = n - 1;
+  soft_left -= n;
+}
+
+static void soft_start(uint8_t cs, uint16_t hi, uint16_t lo) {
+  soft_hi = hi;
+  soft_lo = lo;
+  soft_pinr = &_SFR_MEM8(addr_pin);
+  soft_mask = _BV(addr_bit);
+  soft_phase = 0;
+  soft_left = 0;
+  TCCR0B = 0;
+  TCCR0A = _BV(WGM01);  // CTC
+  TCNT0 = 0;
+  OCR0A = 0;
+  TIFR0 = _BV(OCF0A);
+  TIMSK0 |= _BV(OCIE0A);
+  TCCR0B = cs;
+}
+//
+// Waveform of the BIT pin in the background (hardware OCnx or TIMER0 ISR)
+//
+uint16_t f_pwm = 1000;             // PWM frequency in Hz
+static uint8_t wave_timer = 0xff;  // 0: soft, 1-3: OCnx, 0xff: stopped
+static uint16_t wave_port;         // PORT address of the waveform pin
+static uint8_t wave_mask;          // bit mask of the waveform pin
+
+void wave_stop(void) {
+  uint16_t base;
+  if (wave_timer == 0xff) return;
+  if (wave_timer == 0) {
+    TIMSK0 &= ~_BV(OCIE0A);
+    TCCR0B = 0;
   } else {
-    t_pwm_h = 1;
-    t_fact = t_pwm -1;
+    base = timer_base(wave_timer);
+    _SFR_MEM8(base + 1) = 0;  // TCCRnB: stop
+    _SFR_MEM8(base) = 0;      // TCCRnA: OCnx disconnected
   }
-  if (t_pwm < 1) {
-    t_pwm_l = 0;
-  } else if (t_pwm < 4) {
-    t_pwm_l = 1;
+  _SFR_MEM8(wave_port) &= ~wave_mask;
+  timer_release(wave_timer);
+  wave_timer = 0xff;
+  print_sP(PSTR("BIT WAVE STOP\n"));
+}
+
+//
+// Prepare the BIT pin as output low and find the timer to drive it
+// (OCnx timer if available, 0 for TIMER0 ISR, 0xff if none is free)
+//
+static uint8_t wave_prepare(uint8_t *oc) {
+  uint8_t timer;
+  wave_stop();
+  wave_port = addr_port;
+  wave_mask = _BV(addr_bit);
+  gpio_clr();
+  _SFR_MEM8(addr_ddr) |= wave_mask;  // output
+  *oc = oc_find();
+  timer = (*oc == 0xff) ? 0 : pgm_read_byte(&oc_pins[*oc].timer);
+  if (timer != 0 && (timer_busy & _BV(timer))) timer = 0;
+  if (timer == 0 && !timer_free(0)) return 0xff;
+  return timer;
+}
+
+static void wave_report(uint8_t timer, uint8_t oc, uint32_t ticks) {
+  if (timer == 0) {
+    print_sP(PSTR("soft (TIMER0 ISR)"));
   } else {
-    t_pwm_l = t_pwm - 2;
+    print_sP(PSTR("OC"));
+    print_hex1(timer);
+    print_c('A' + pgm_read_byte(&oc_pins[oc].ch));
   }
-  print_sP(PSTR("BIT PWM WIDTH HIGH="));
-  print_hex2(t_pwm_h);
-  print_sP(PSTR(" LOW="));
-  print_hex2(t_pwm_l);
-  print_crlf();
-  for (uint16_t time = (tspan/t_fact); time > 0; time --) {
-    // HIGH
-    _SFR_MEM8(addr_port) |= _BV(addr_bit);
-    for (uint16_t t = (uint16_t) unit * t_pwm_h; t > 0; t--) {
-      _delay_ms(1);
-    }
-    // LOW
-    _SFR_MEM8(addr_port) &= ~ _BV(addr_bit);
-    for (uint16_t t = (uint16_t) unit * t_pwm_l; t > 0; t--) {
-      _delay_ms(1);
+  wave_timer = timer;
+  timer_take(timer);
+  print_sP(PSTR(" f="));
+  print_dec((F_CPU + ticks / 2) / ticks);
+  print_sP(PSTR(" Hz (BWX to stop)\n"));
+}
+
+//
+// PWM of the BIT pin: duty/0x100 at f_pwm Hz
+//
+void bit_wave(char *duty, char *freq) {
+  uint8_t oc;
+  uint8_t timer;
+  uint8_t ch;
+  uint8_t cs;
+  uint8_t shift;
+  uint32_t n;
+  uint16_t base;
+  uint32_t ticks;
+  if (duty != NULL && *duty != '\0') t_pwm = str2byte(duty);
+  if (freq != NULL && *freq != '\0') f_pwm = str2word(freq);
+  if (f_pwm == 0) f_pwm = 1000;
+  timer = wave_prepare(&oc);
+  print_sP(PSTR("BIT PWM duty="));
+  print_hex2(t_pwm);
+  print_sP(PSTR("/100 "));
+  if (timer == 0xff) return;
+  if (t_pwm == 0) {
+    print_sP(PSTR("(low)\n"));
+    return;
+  }
+  ticks = F_CPU / f_pwm;
+  if (timer != 0) {
+    // hardware OCnx (non-inverting fast PWM)
+    ch = pgm_read_byte(&oc_pins[oc].ch);
+    base = timer_base(timer);
+    _SFR_MEM8(base + 1) = 0;
+    if (timer != 2) {
+      // 16 bit: mode 14, TOP = ICRn
+      cs = timer_prescale(ticks, 0x10000, cs_shift16, 5, &shift);
+      n = timer_counts(ticks, shift, 0x10000);
+      _SFR_MEM16(base + 6) = n - 1;  // ICRn
+      _SFR_MEM16(base + 8 + 2 * ch) = (n * t_pwm) >> 8;  // OCRnx
+      _SFR_MEM16(base + 4) = 0;  // TCNTn
+      _SFR_MEM8(base) = _BV(7 - 2 * ch) | _BV(WGM11);
+      _SFR_MEM8(base + 1) = _BV(WGM13) | _BV(WGM12) | cs;
+    } else {
+      // 8 bit: mode 3, TOP = 0xff
+      cs = timer_prescale(ticks, 0x100, cs_shift2, 7, &shift);
+      n = 0x100;
+      _SFR_MEM8(base + 3 + ch) = t_pwm;  // OCR2x
+      _SFR_MEM8(base + 2) = 0;  // TCNT2
+      _SFR_MEM8(base) = _BV(7 - 2 * ch) | _BV(WGM21) | _BV(WGM20);
+      _SFR_MEM8(base + 1) = cs;
     }
+    ticks = n << shift;
+  } else {
+    // TIMER0 ISR at clk/64
+    n = timer_counts(ticks, 6, 0xffff);
+    if (n < 4) n = 4;
+    ticks = (n * t_pwm) >> 8;  // high phase
+    if (ticks < 2) ticks = 2;
+    if (ticks > n - 2) ticks = n - 2;
+    soft_start(_BV(CS01) | _BV(CS00), ticks, n - ticks);
+    ticks = n << 6;
   }
-  print_sP(PSTR("BIT WAVE END\n"));
+  wave_report(timer, oc, ticks);
 }
 
-void bit_record(void) {
-  uint8_t s; // state
-  // s: state
-  // 0: original state 0
-  // 1:0->2: transitional to 2
-  // 2: alt. state 2
-  // 3: 2->0: transitional to 0
-  // 0: original state after trigger (=0)
-  uint8_t x; // current data
-  uint16_t xx; // trigger direction
-  uint8_t x0; // previous data
-  uint16_t t; // time lapse (cumulative)
-  uint16_t t0; // time lapse of the last trigger
-  uint16_t td; // time lapse since the last trigger
-  uint16_t i; // data[] record index
-  uint16_t i0; // data[] record index (old)
-  print_sP(PSTR("RECORDING one BIT PIN START\n"));
-  x = _SFR_MEM8(addr_pin) & _BV(addr_bit);
-  if (x) {
-    xx = 0xf000; // high -> low as start
+//
+// Square wave of f Hz (1 ... F_CPU/2) on the BIT pin
+//
+// OCnx pins toggle in hardware (CTC), giving F_CPU / (2 * N * (TOP + 1))
+// exactly.  Other pins are toggled by the TIMER0 ISR up to about F_CPU/128.
+//
+void bit_generate(uint32_t f) {
+  uint8_t oc;
+  uint8_t timer;
+  uint8_t ch;
+  uint8_t cs;
+  uint8_t shift;
+  uint32_t n;
+  uint16_t base;
+  uint32_t half;  // half period in CPU cycles
+  if (f == 0) f = 1;
+  if (f > F_CPU / 2) f = F_CPU / 2;
+  half = (F_CPU + f) / (2 * f);
+  timer = wave_prepare(&oc);
+  print_sP(PSTR("BIT GENERATOR "));
+  if (timer == 0xff) return;
+  if (timer != 0) {
+    ch = pgm_read_byte(&oc_pins[oc].ch);
+    base = timer_base(timer);
+    _SFR_MEM8(base + 1) = 0;
+    if (timer != 2) {
+      // 16 bit: mode 12 (CTC, TOP = ICRn), toggle OCnx on match
+      cs = timer_prescale(half, 0x10000, cs_shift16, 5, &shift);
+      n = timer_counts(half, shift, 0x10000);
+      _SFR_MEM16(base + 6) = n - 1;  // ICRn
+      _SFR_MEM16(base + 8 + 2 * ch) = 0;  // OCRnx
+      _SFR_MEM16(base + 4) = 0;  // TCNTn
+      _SFR_MEM8(base) = _BV(6 - 2 * ch);
+      _SFR_MEM8(base + 1) = _BV(WGM13) | _BV(WGM12) | cs;
+    } else {
+      // 8 bit: mode 2 (CTC, TOP = OCR2A), toggle OC2x on match
+      cs = timer_prescale(half, 0x100, cs_shift2, 7, &shift);
+      n = timer_counts(half, shift, 0x100);
+      _SFR_MEM8(base + 3) = n - 1;  // OCR2A
+      if (ch) _SFR_MEM8(base + 4) = 0;  // OCR2B
+      _SFR_MEM8(base + 2) = 0;  // TCNT2
+      _SFR_MEM8(base) = _BV(6 - 2 * ch) | _BV(WGM21);
+      _SFR_MEM8(base + 1) = cs;
+    }
   } else {
-    xx = 0x0f00; // low -> high as start
+    if (half < 64) {
+      print_sP(PSTR("\nE: too fast for TIMER0 ISR, use an OCnx pin\n"));
+      return;
+    }
+    // single chunk if possible, else chunked phases at clk/1024
+    cs = timer_prescale(half, 0x100, cs_shift16, 5, &shift);
+    n = timer_counts(half, shift, 0xffff);
+    soft_start(cs, n, n);
   }
-  data[0] = xx; // trigger direction
-  // original state
-  s = 0;
-  t = 0; // cumulative time
-  t0 = 0; // t @ last trigger
-  td = 0; // del(t)
-  i = 1; // record index
-  i0 = 0; // record index
-  if  (unit != 0) {
-    // reasonable unit in ms given
-    while ((i < DATASIZE - 2) && (t < tspan)) {
-      if (s == 0) {
-        t = 0;  // not-triggered
-        td = 0; // not-triggered
-        t0 = 0; // not-triggered
-      }
-      t ++;
-      td++;
-      for (uint8_t t = unit; t == 0; t--) {
-        _delay_ms(1);
-      }
-      x0 = x; // one older value
-      x = _SFR_MEM8(addr_pin) & _BV(addr_bit);
-      if (x != x0) {
-        if (s == 0) {
-          s = 1;
-          t0 = t;
-          td = 0;
-          i0 = i;
-          data[i++] = t;
-        } else if (s == 1) {
-          if (td < tcount) {
-            s = 4;
-            i = i0;
-            td = t - t0;
-          } else {
-            s = 2;
-          }
+  wave_report(timer, oc, (n << shift) * 2);
+}
+
+//
+// Pattern generator: replay data[] (BYTE DUMP format) onto the BIT port
+//
+// TIMER1 (CTC) paces the output.  Only active output pins (MASK and DDR)
+// of the port are driven; they are updated with a single store to PINx.
+//
+static volatile uint8_t *pat_pinr;   // PINx of the pattern port
+static volatile uint8_t *pat_portr;  // PORTx of the pattern port
+static uint8_t pat_mask;             // driven pins
+static volatile uint16_t pat_i;      // data[] index of the next byte
+static uint16_t pat_end;             // data[] index of the end marker
+static uint8_t pat_loop;             // 1: loop, 0: one-shot
+// ISR costs about 100 clk (prologue, pointer and data[] loads): keep a
+// margin so the replay rate holds and the command line stays usable
+#define PAT_MIN_TICKS 0x100
+
+ISR(TIMER1_COMPA_vect) {
+  *pat_pinr = (*pat_portr ^ (uint8_t)data[pat_i]) & pat_mask;
+  if (++pat_i >= pat_end) {
+    if (pat_loop) {
+      pat_i = 1;
+    } else {
+      TCCR1B = 0;
+      TIMSK1 &= ~_BV(OCIE1A);
+      timer_busy &= ~_BV(1);
+    }
+  }
+}
+
+void pattern_stop(void) {
+  if (!(TIMSK1 & _BV(OCIE1A))) return;
+  TIMSK1 &= ~_BV(OCIE1A);
+  TCCR1B = 0;
+  timer_release(1);
+  print_sP(PSTR("PATTERN STOP at "));
+  print_hex4(pat_i);
+  print_crlf();
+}
+
+void pattern_play(uint16_t rate, char *mode) {
+  uint8_t cs;
+  uint8_t shift;
+  uint32_t ticks;
+  uint32_t n;
+  if (data[0] != 0x8888) {
+    print_sP(PSTR("E: no BYTE DUMP data (BP or BPU first)\n"));
+    return;
+  }
+  for (pat_end = 1; pat_end < DATASIZE; pat_end++) {
+    if (data[pat_end] == 0xffff) break;
+  }
+  if (pat_end < 2) {
+    print_sP(PSTR("E: empty pattern\n"));
+    return;
+  }
+  if (rate == 0) rate = 1000;
+  ticks = F_CPU / rate;
+  if (ticks < PAT_MIN_TICKS) {
+    print_sP(PSTR("E: too fast for TIMER1 ISR (max "));
+    print_dec(F_CPU / PAT_MIN_TICKS);
+    print_sP(PSTR(" Hz)\n"));
+    return;
+  }
+  if (!timer_free(1)) return;
+  pat_pinr = &_SFR_MEM8(addr_pin);
+  pat_portr = &_SFR_MEM8(addr_port);
+  pat_mask = mask[addr_mask] & _SFR_MEM8(addr_ddr);
+  pat_loop = (mode != NULL && *mode == 'L');
+  pat_i = 1;
+  cs = timer_prescale(ticks, 0x10000, cs_shift16, 5, &shift);
+  n = timer_counts(ticks, shift, 0x10000);
+  timer_take(1);
+  TCCR1B = 0;
+  TCCR1A = 0;
+  TCNT1 = 0;
+  OCR1A = n - 1;
+  TIFR1 = _BV(OCF1A);
+  TIMSK1 |= _BV(OCIE1A);
+  TCCR1B = _BV(WGM12) | cs;  // CTC, TOP = OCR1A
+  print_sP(PSTR("PATTERN "));
+  print_hex4(pat_end - 1);
+  print_sP(PSTR(" bytes MASK="));
+  print_bin8(pat_mask, 0xff);
+  print_sP(PSTR(" rate="));
+  print_dec(F_CPU / (n << shift));
+  print_sP(pat_loop ? PSTR(" Hz loop") : PSTR(" Hz one-shot"));
+  print_sP(PSTR(" (BPX to stop)\n"));
+}
+
+//
+// Upload a binary pattern of n bytes from the terminal into data[]
+//
+// A gap of RAW_TIMEOUT ms ends a short upload with the bytes received.
+//
+#define RAW_TIMEOUT 0x3e8  // ms
+
+void pattern_upload(uint16_t n) {
+  uint16_t i;
+  int16_t c;
+  if (n > DATASIZE - 2) n = DATASIZE - 2;
+  pattern_stop();
+  print_sP(PSTR("Send "));
+  print_hex4(n);
+  print_sP(PSTR(" bytes in binary\n"));
+  data[0] = 0x8888;  // byte record
+  for (i = 1; i <= n; i++) {
+    if ((c = input_raw_ms(RAW_TIMEOUT)) < 0) break;
+    data[i] = c;
+  }
+  data[i] = 0xffff;  // end of data marker
+  if (i <= n) {
+    print_sP(PSTR("E: timeout, got "));
+    print_hex4(i - 1);
+    print_sP(PSTR(" bytes\n"));
+    return;
+  }
+  print_sP(PSTR("PATTERN UPLOADED\n"));
+}
+
+//
+// TIMER1 time base for foreground jobs (count extended to 32 bit)
+//
+#define T1_TPS (F_CPU / 1024)  // TIMER1 ticks per second
+#define T1_CLK1024 (_BV(CS12) | _BV(CS10))
+
+static volatile uint16_t t1_ovf;    // TIMER1 overflows
+static volatile uint16_t t1_epoch;  // t1_ovf wraps
+
+ISR(TIMER1_OVF_vect) {
+  if (++t1_ovf == 0) t1_epoch++;
+}
+
+static uint32_t t1_time(void) {
+  uint16_t hi, lo;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    lo = TCNT1;
+    hi = t1_ovf;
+    if ((TIFR1 & _BV(TOV1)) && lo < 0x8000) hi++;  // pending overflow
+  }
+  return ((uint32_t)hi << 16) | lo;
+}
+
+static uint8_t t1_start(uint8_t cs) {
+  if (!timer_free(1)) return 0;
+  t1_ovf_use = ++t1_uses;
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  t1_ovf = 0;
+  t1_epoch = 0;
+  TIFR1 = _BV(TOV1);
+  TIMSK1 |= _BV(TOIE1);
+  TCCR1B = cs;
+  return 1;
+}
+
+// stop TIMER1 (T1_CLK1024), print the elapsed time and return it in 1/100 s
+static uint32_t t1_stop(void) {
+  uint32_t dt = t1_time();
+  uint32_t cs;
+  TCCR1B = 0;
+  TIMSK1 &= ~_BV(TOIE1);
+  cs = (dt / T1_TPS) * 100 + (dt % T1_TPS) * 100 / T1_TPS;
+  print_sP(PSTR("TIME="));
+  print_dec(cs / 100);
+  print_c('.');
+  print_c('0' + (cs % 100) / 10);
+  print_c('0' + cs % 10);
+  print_sP(PSTR(" s"));
+  return cs;
+}
+
+//
+// LED animation: frames shown on a TIMER1 schedule
+//
+// A late frame is shown at once and the slots it missed are counted as
+// dropped, so the achieved rate tells what the string length allows.
+//
+#define LED_ANIM_W 4            // LEDs in a built-in frame (repeated)
+static const uint8_t led_anim[][3 * LED_ANIM_W] PROGMEM = {
+  // G     R     B
+  {0xff, 0x00, 0x00,  0x00, 0xff, 0x00,  0x00, 0x00, 0xff,  0x00, 0x00, 0x00},
+  {0x00, 0x00, 0x00,  0xff, 0x00, 0x00,  0x00, 0xff, 0x00,  0x00, 0x00, 0xff},
+  {0x00, 0x00, 0xff,  0x00, 0x00, 0x00,  0xff, 0x00, 0x00,  0x00, 0xff, 0x00},
+  {0x00, 0xff, 0x00,  0x00, 0x00, 0xff,  0x00, 0x00, 0x00,  0xff, 0x00, 0x00},
+  {0xff, 0xff, 0xff,  0xff, 0xff, 0xff,  0xff, 0xff, 0xff,  0xff, 0xff, 0xff},
+  {0x00, 0x00, 0x00,  0x00, 0x00, 0x00,  0x00, 0x00, 0x00,  0x00, 0x00, 0x00},
+};
+#define LED_ANIM_N (sizeof(led_anim) / sizeof(led_anim[0]))
+
+static uint8_t led_start(uint8_t fps, uint16_t *period) {
+  if (!t1_start(T1_CLK1024)) return 0;
+  if (fps == 0) fps = 0x1e;
+  *period = T1_TPS / fps;
+  gpio_clr();
+  _delay_us(300); // reset (latch) for WS2812 and WS2812B
+  return 1;
+}
+
+// wait for the frame slot at *due, return the number of missed slots
+static uint32_t led_wait(uint32_t *due, uint16_t period) {
+  uint32_t late;
+  while ((int32_t)(t1_time() - *due) < 0) ;
+  late = (t1_time() - *due) / period;
+  *due += (late + 1) * period;
+  return late;
+}
+
+static void led_show(void) {
+  if (pix_hw) {
+    pix_start(pixled, ledlen);
+    return;
+  }
+  ws2812_send(pixled, ledlen);
+  _delay_us(300); // latch
+}
+
+static void led_report(uint32_t shown, uint32_t dropped, uint8_t fps) {
+  uint32_t cs; // elapsed time in 1/100 s
+  cs = t1_stop();
+  if (fps == 0) fps = 0x1e;
+  print_sP(PSTR(" FRAMES="));
+  print_dec(shown);
+  print_sP(PSTR(" DROPPED="));
+  print_dec(dropped);
+  print_sP(PSTR(" FPS="));
+  if (cs) {
+    cs = shown * 1000 / cs;  // FPS in 1/10
+    print_dec(cs / 10);
+    print_c('.');
+    print_c('0' + cs % 10);
+  } else {
+    print_c('-');
+  }
+  print_sP(PSTR(" (target "));
+  print_dec(fps);
+  print_sP(PSTR(")\n"));
+}
+
+//
+// Play the built-in PROGMEM frames along the string until a key is pressed
+//
+void led_play(uint8_t fps) {
+  uint16_t period;
+  uint32_t due = 0;
+  uint32_t shown = 0;
+  uint32_t dropped = 0;
+  uint16_t i;
+  uint8_t j;
+  uint8_t f = 0;
+  if (ledlen < 3) {
+    print_sP(PSTR("E: no LED (BXN to set)\n"));
+    return;
+  }
+  if (!led_start(fps, &period)) return;
+  print_sP(PSTR("LED ANIMATION START\n"));
+  do {
+    pix_wait();
+    for (i = 0, j = 0; i < ledlen; i++) {
+      pixled[i] = pgm_read_byte(&led_anim[f][j]);
+      if (++j == 3 * LED_ANIM_W) j = 0;
+    }
+    if (++f == LED_ANIM_N) f = 0;
+    dropped += led_wait(&due, period);
+    led_show();
+    shown++;
+  } while (!check_input());
+  led_report(shown, dropped, fps);
+}
+
+//
+// Show n frames of LED data streamed in binary from the terminal
+//
+// Each frame (3 * #LEDs bytes) is requested with '>' so that no byte is
+// sent while interrupts are disabled by the LED output.
+//
+void led_stream(uint16_t n, uint8_t fps) {
+  uint16_t period;
+  uint32_t due = 0;
+  uint32_t dropped = 0;
+  uint16_t k;
+  uint16_t i;
+  int16_t c;
+  if (ledlen < 3) {
+    print_sP(PSTR("E: no LED (BXN to set)\n"));
+    return;
+  }
+  if (!led_start(fps, &period)) return;
+  print_sP(PSTR("Send "));
+  print_hex4(n);
+  print_sP(PSTR(" frames of "));
+  print_hex4(ledlen);
+  print_sP(PSTR(" bytes in binary after each '>'\n"));
+  for (k = 0; k < n; k++) {
+    pix_wait();
+    print_c('>');
+    for (i = 0; i < ledlen; i++) {
+      if ((c = input_raw_ms(RAW_TIMEOUT)) < 0) break;
+      pixled[i] = c;
+    }
+    if (i < ledlen) {
+      print_sP(PSTR("\nE: timeout in frame "));
+      print_hex4(k);
+      break;
+    }
+    dropped += led_wait(&due, period);
+    led_show();
+  }
+  print_crlf();
+  led_report(k, dropped, fps);  // stops TIMER1
+}
+
+void bit_record(void) {
+  uint8_t s; // state
+  // s: state
+  // 0: original state 0
+  // 1:0->2: transitional to 2
+  // 2: alt. state 2
+  // 3: 2->0: transitional to 0
+  // 0: original state after trigger (=0)
+  uint8_t x; // current data
+  uint16_t xx; // trigger direction
+  uint8_t x0; // previous data
+  uint16_t t; // time lapse (cumulative)
+  uint16_t t0; // time lapse of the last trigger
+  uint16_t td; // time lapse since the last trigger
+  uint16_t i; // data[] record index
+  uint16_t i0; // data[] record index (old)
+  print_sP(PSTR("RECORDING one BIT PIN START\n"));
+  x = _SFR_MEM8(addr_pin) & _BV(addr_bit);
+  if (x) {
+    xx = 0xf000; // high -> low as start
+  } else {
+    xx = 0x0f00; // low -> high as start
+  }
+  data[0] = xx; // trigger direction
+  // original state
+  s = 0;
+  t = 0; // cumulative time
+  t0 = 0; // t @ last trigger
+  td = 0; // del(t)
+  i = 1; // record index
+  i0 = 0; // record index
+  if  (unit != 0) {
+    // reasonable unit in ms given
+    while ((i < DATASIZE - 2) && (t < tspan)) {
+      if (s == 0) {
+        t = 0;  // not-triggered
+        td = 0; // not-triggered
+        t0 = 0; // not-triggered
+      }
+      t ++;
+      td++;
+      for (uint8_t t = unit; t == 0; t--) {
+        _delay_ms(1);
+      }
+      x0 = x; // one older value
+      x = _SFR_MEM8(addr_pin) & _BV(addr_bit);
+      if (x != x0) {
+        if (s == 0) {
+          s = 1;
+          t0 = t;
+          td = 0;
+          i0 = i;
+          data[i++] = t;
+        } else if (s == 1) {
+          if (td < tcount) {
+            s = 4;
+            i = i0;
+            td = t - t0;
+          } else {
+            s = 2;
+          }
         } else if (s == 2) {
           s = 3;
           t0 = t;
@@ -939,6 +1801,585 @@ void bit_record_pins(void) {
   print_sP(PSTR("RECORDING PINS END\n"));
 }
 
+//
+// Switch bounce analyzer: record press/release events of the BIT pin
+//
+// An event starts with the first edge and ends after qms ms without an
+// edge.  Its duration (first to last edge, TIMER1 clk/64) and number of
+// bounces (extra edges) are kept in data[] as pairs for BD:
+//   data[0] = 0xbb00, data[2i+1] = duration, data[2i+2] = bounces |
+//   0x100 (started high) | 0x200 (glitch: ended at the start level)
+//
+#define BOUNCE_US(t) ((uint32_t)(t) * 64 / (F_CPU / 1000000UL))
+static const uint8_t bounce_pct[] PROGMEM = {50, 90, 99, 100};
+
+// k-th smallest (k from 0) of data[first + 2i] & vmask, i < n
+static uint16_t bounce_kth(uint16_t first, uint16_t vmask, uint16_t n, uint16_t k) {
+  uint16_t lo = 0, hi = vmask, v, c, i;
+  while (lo < hi) {
+    v = lo + (hi - lo) / 2;
+    c = 0;
+    for (i = 0; i < n; i++) {
+      if ((data[first + 2 * i] & vmask) <= v) c++;
+    }
+    if (c > k) {
+      hi = v;
+    } else {
+      lo = v + 1;
+    }
+  }
+  return lo;
+}
+
+static void bounce_bar(uint16_t c, uint16_t n) {
+  print_sP(PSTR(": "));
+  print_hex4(c);
+  print_c(' ');
+  for (c = (uint32_t)c * 40 / n; c; c--) print_c('*');
+  print_crlf();
+}
+
+void bit_bounce(uint16_t nmax, uint8_t qms) {
+  uint8_t x, x0, xs;   // BIT pin now, last, at the event start
+  uint16_t ovf = 0;    // TIMER1 overflows (clk/64)
+  uint16_t t;
+  uint32_t now, tf = 0, tl = 0;  // now, first and last edge
+  uint32_t q;          // quiet time (ticks)
+  uint16_t edges = 0;  // edges of this event (0: idle)
+  uint16_t n = 0;      // events
+  uint16_t c[9];       // histogram
+  uint16_t i, k, v;
+  uint16_t nh = 0;     // events started high
+  uint16_t ng = 0;     // glitches
+  uint8_t j;
+  if (!timer_free(1)) return;
+  if (nmax == 0) nmax = 0x14;
+  if (nmax > (DATASIZE - 2) / 2) nmax = (DATASIZE - 2) / 2;
+  if (qms == 0) qms = 0x0a;
+  q = (uint32_t)qms * (F_CPU / 64 / 1000);
+  print_sP(PSTR("BOUNCE ANALYZER START (quiet "));
+  print_hex2(qms);
+  print_sP(PSTR(" ms, "));
+  print_hex4(nmax);
+  print_sP(PSTR(" events)\n"));
+  data[0] = 0xbb00;
+  data[1] = 0xffff;
+  t1_uses++;
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  TIFR1 = _BV(TOV1);
+  TCCR1B = _BV(CS11) | _BV(CS10);  // clk/64
+  x0 = _SFR_MEM8(addr_pin) & _BV(addr_bit);
+  xs = x0;
+  while (n < nmax) {
+    x = _SFR_MEM8(addr_pin) & _BV(addr_bit);
+    t = TCNT1;
+    if (TIFR1 & _BV(TOV1)) {
+      TIFR1 = _BV(TOV1);
+      ovf++;
+      t = TCNT1;
+    }
+    now = ((uint32_t)ovf << 16) | t;
+    if (x != x0) {
+      if (edges == 0) {
+        tf = now;
+        xs = x0;
+      }
+      tl = now;
+      edges++;
+      x0 = x;
+    } else if (edges) {
+      if (now - tl > q) {
+        // event done
+        v = (tl - tf > 0xfffe) ? 0xfffe : tl - tf;
+        data[2 * n + 1] = v;
+        data[2 * n + 2] = ((edges - 1 > 0xff) ? 0xff : edges - 1) |
+                          (xs ? 0x100 : 0) | ((x == xs) ? 0x200 : 0);
+        n++;
+        data[2 * n + 1] = 0xffff;
+        edges = 0;
+        ovf = 0;  // keep the 32 bit time far from wrapping
+        TCNT1 = 0;
+        TIFR1 = _BV(TOV1);
+        x0 = x;
+      }
+    } else if (check_input()) {
+      break;
+    }
+  }
+  TCCR1B = 0;
+  // report
+  print_sP(PSTR("EVENTS="));
+  print_hex4(n);
+  for (i = 0; i < n; i++) {
+    if (data[2 * i + 2] & 0x100) nh++;
+    if (data[2 * i + 2] & 0x200) ng++;
+  }
+  print_sP(PSTR(" H->L="));
+  print_hex4(nh);
+  print_sP(PSTR(" L->H="));
+  print_hex4(n - nh);
+  print_sP(PSTR(" GLITCH="));
+  print_hex4(ng);
+  print_crlf();
+  if (n == 0) return;
+  // bounce count histogram: 0 ... 7, 8+
+  for (j = 0; j < 9; j++) c[j] = 0;
+  for (i = 0; i < n; i++) {
+    v = data[2 * i + 2] & 0xff;
+    c[(v > 8) ? 8 : v]++;
+  }
+  print_sP(PSTR("BOUNCES\n"));
+  for (j = 0; j < 9; j++) {
+    print_sP(PSTR("  "));
+    print_hex1(j);
+    print_c((j == 8) ? '+' : ' ');
+    bounce_bar(c[j], n);
+  }
+  // duration histogram: < 2^(j+1) ticks for j = 0 ... 7, longer
+  for (j = 0; j < 9; j++) c[j] = 0;
+  for (i = 0; i < n; i++) {
+    v = data[2 * i + 1];
+    for (j = 0; j < 8 && (v >> (2 * j + 1)); j++) ;
+    c[j]++;
+  }
+  print_sP(PSTR("DURATION (us)\n"));
+  for (j = 0; j < 9; j++) {
+    print_sP((j < 8) ? PSTR("  < ") : PSTR("  >="));
+    print_dec(BOUNCE_US(1UL << (2 * ((j < 8) ? j : 7) + 1)));
+    bounce_bar(c[j], n);
+  }
+  // percentiles
+  print_sP(PSTR("PERCENTILE    50%    90%    99%    MAX\n"));
+  for (j = 0; j < 2; j++) {
+    print_sP(j ? PSTR("BOUNCES ") : PSTR("us      "));
+    for (i = 0; i < sizeof(bounce_pct); i++) {
+      k = (uint32_t)(n - 1) * pgm_read_byte(&bounce_pct[i]) / 100;
+      print_sP(PSTR("  "));
+      if (j) {
+        print_dec(bounce_kth(2, 0xff, n, k));
+      } else {
+        print_dec(BOUNCE_US(bounce_kth(1, 0xffff, n, k)));
+      }
+    }
+    print_crlf();
+  }
+}
+
+//
+// Frequency meter: T1 counting (>= 10 kHz) or ICP1 input capture
+//
+// TIMER0 (1 ms, COMPB) gates TIMER1 counting T1 edges: both ends of the
+// gate read TIMER1 in the same ISR so the ISR latency cancels out.  Below
+// 10 kHz, up to 0xff periods within 100 ms are timed with input capture
+// (clk/1) on both edges for period, duty cycle and jitter.  Connect the
+// signal to both pins.
+//
+#define METER_TICKS_MS (F_CPU / 64 / 1000)  // TIMER0 clk/64 counts per ms
+static volatile uint16_t gate_n;   // gate ms left
+static uint16_t gate_len;          // gate length in ms
+static volatile uint32_t gate_t0;  // TIMER1 at the gate start
+static volatile uint32_t gate_t1;  // TIMER1 at the gate end
+
+ISR(TIMER0_COMPB_vect) {
+  uint32_t t = t1_time();
+  if (gate_n == gate_len) gate_t0 = t;
+  if (--gate_n == 0) {
+    gate_t1 = t;
+    TIMSK0 &= ~_BV(OCIE0B);
+  }
+}
+
+static uint32_t meter_count(uint16_t ms) {
+  t1_start(_BV(CS12) | _BV(CS11) | _BV(CS10));  // T1 rising edge
+  gate_len = ms + 1;  // + 1 ms to start
+  gate_n = gate_len;
+  TCCR0B = 0;
+  TCCR0A = _BV(WGM01);  // CTC, TOP = OCR0A
+  TCNT0 = 0;
+  OCR0A = METER_TICKS_MS - 1;
+  OCR0B = 0;
+  TIFR0 = _BV(OCF0B);
+  TIMSK0 |= _BV(OCIE0B);
+  TCCR0B = _BV(CS01) | _BV(CS00);  // clk/64
+  while (gate_n) ;
+  TCCR0B = 0;
+  TCCR1B = 0;
+  TIMSK1 &= ~_BV(TOIE1);
+  return gate_t1 - gate_t0;
+}
+
+// TIMER1 clk/1 ticks to ns
+static uint32_t meter_ns(uint32_t t) {
+  return (t / (F_CPU / 1000000UL)) * 1000 + (t % (F_CPU / 1000000UL)) * 1000 / (F_CPU / 1000000UL);
+}
+
+static uint32_t meter_isqrt(uint32_t x) {
+  uint32_t r = 0, b = 1UL << 30;
+  while (b > x) b >>= 2;
+  while (b) {
+    if (x >= r + b) {
+      x -= r + b;
+      r = (r >> 1) + b;
+    } else {
+      r >>= 1;
+    }
+    b >>= 2;
+  }
+  return r;
+}
+
+// return 0 if no signal
+static uint8_t meter_capture(void) {
+  uint16_t ovf = 0;       // TIMER1 overflows
+  uint16_t idle = 0;      // overflows since the last edge
+  uint16_t t;
+  uint32_t now;
+  uint32_t tr = 0;        // last rising edge
+  uint32_t tf = 0;        // last falling edge
+  uint32_t ts = 0;        // first rising edge
+  uint32_t p, p0 = 0, pmin = 0xffffffff, pmax = 0;
+  uint32_t sp = 0;        // sum of periods
+  uint32_t sh = 0;        // sum of high times
+  int32_t d, sd = 0;      // deviation from the first period
+  uint64_t sdd = 0;
+  int64_t v;
+  uint8_t n = 0;          // periods
+  uint8_t rise = 0;       // rising edges seen
+  t1_uses++;
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  TIFR1 = _BV(ICF1) | _BV(TOV1);
+  TCCR1B = _BV(ICES1) | _BV(CS10);  // rising edge, clk/1
+  while (n < 0xff) {
+    if ((TIFR1 & _BV(TOV1)) && !(TIFR1 & _BV(ICF1))) {
+      TIFR1 = _BV(TOV1);
+      ovf++;
+      if (++idle > 2 * (F_CPU >> 16)) break;  // no edge for 2 s
+    }
+    if (TIFR1 & _BV(ICF1)) {
+      t = ICR1;
+      TCCR1B ^= _BV(ICES1);  // next edge is the opposite one
+      if ((TIFR1 & _BV(TOV1)) && t < 0x8000) {
+        TIFR1 = _BV(TOV1);
+        ovf++;
+      }
+      TIFR1 = _BV(ICF1);
+      now = ((uint32_t)ovf << 16) + t;
+      idle = 0;
+      if (TCCR1B & _BV(ICES1)) {
+        tf = now;  // falling edge (next is rising)
+        continue;
+      }
+      if (rise++ == 0) {
+        ts = now;
+      } else {
+        p = now - tr;
+        if (n == 0) p0 = p;
+        if (p < pmin) pmin = p;
+        if (p > pmax) pmax = p;
+        sp += p;
+        sh += tf - tr;
+        d = p - p0;
+        sd += d;
+        sdd += (int64_t)d * d;
+        n++;
+      }
+      tr = now;
+      if (now - ts >= 100 * (F_CPU / 1000) && n) break;
+    }
+  }
+  TCCR1B = 0;
+  if (n == 0) return 0;
+  // frequency in 1/100 Hz: N * F_CPU < 2^32 for N <= 0xff
+  p = (uint32_t)n * F_CPU;
+  print_sP(PSTR("F="));
+  print_dec(p / sp);
+  print_c('.');
+  p = (p % sp) * 100 / sp;
+  print_c('0' + p / 10);
+  print_c('0' + p % 10);
+  print_sP(PSTR(" Hz T="));
+  print_dec(meter_ns(sp / n));
+  print_sP(PSTR(" ns DUTY="));
+  while (sp > 0x400000) {
+    sp >>= 1;
+    sh >>= 1;
+  }
+  p = sh * 1000 / sp;
+  print_dec(p / 10);
+  print_c('.');
+  print_c('0' + p % 10);
+  print_sP(PSTR(" % MIN="));
+  print_dec(meter_ns(pmin));
+  print_sP(PSTR(" MAX="));
+  print_dec(meter_ns(pmax));
+  print_sP(PSTR(" SD="));
+  d = sd / n;
+  v = sdd / n - (int64_t)d * d;  // variance
+  if (v < 0) v = 0;
+  if (v > 0xffffffffL) v = 0xffffffffL;
+  print_dec(meter_ns(meter_isqrt(v)));
+  print_sP(PSTR(" ns N="));
+  print_hex2(n);
+  print_crlf();
+  return 1;
+}
+
+void freq_meter(void) {
+  uint16_t gate = 100;  // ms
+  uint32_t f;
+  if (!timer_free(0) || !timer_free(1)) return;
+  FREQ_DDR_INPUT;
+  print_sP(PSTR("FREQUENCY METER " FREQ_PINS " (input)\n"));
+  do {
+    f = meter_count(gate) * (1000 / gate);
+    if (f < 10000) {
+      gate = 100;
+      if (!meter_capture()) print_sP(PSTR("NO SIGNAL\n"));
+      continue;
+    }
+    print_sP(PSTR("F="));
+    print_dec(f);
+    print_sP(PSTR(" Hz (GATE="));
+    print_dec(gate);
+    print_sP(PSTR(" ms)\n"));
+    gate = (f < 1000000) ? 1000 : 100;  // 1 Hz resolution up to 1 MHz
+  } while (!check_input());
+}
+
+//
+// Glitch counter (background): pulses narrower than gl_width on the active
+// INPUT pins of the PCINT ports
+//
+// The pin change ISR timestamps edges with TIMER1 (clk/8).  A pin with 2
+// edges closer than gl_width made a glitch.  An interrupt without any
+// changed pin means a pulse shorter than the ISR latency (pin unknown).
+//
+#define GL_RING 8
+#define GL_TPS (F_CPU / 8)  // TIMER1 ticks per second
+struct glitch {
+  uint16_t ep;  // time: t1_epoch
+  uint32_t t;   // time: t1_ovf, TCNT1
+  uint8_t pin;  // port << 3 | bit, 0xff: unknown
+  uint16_t w;   // width in ticks, 0: shorter than the ISR latency
+};
+static const uint8_t pcint_port[PCINT_N] PROGMEM = {PCINT_PORTS};
+static const uint8_t pcint_skip[PCINT_N] PROGMEM = {PCINT_SKIP};
+static uint8_t gl_on;                   // counting
+static uint16_t gl_width;               // ticks
+static uint8_t gl_last[PCINT_N];        // last PINx
+static uint32_t gl_edge[8 * PCINT_N];   // last edge of each pin
+static uint16_t gl_count[8 * PCINT_N];  // glitches of each pin
+static volatile uint32_t gl_edges;      // edges
+static volatile uint32_t gl_total;      // glitches
+static volatile uint32_t gl_fast;       // glitches shorter than the ISR
+static struct glitch gl_ring[GL_RING];  // latest glitches
+static volatile uint8_t gl_head;        // next gl_ring[] entry
+
+static inline void glitch_log(uint16_t ep, uint32_t t, uint8_t pin, uint16_t w) {
+  struct glitch *p = &gl_ring[gl_head];
+  p->ep = ep;
+  p->t = t;
+  p->pin = pin;
+  p->w = w;
+  gl_head = (gl_head + 1) % GL_RING;
+  gl_total++;
+}
+
+static inline void glitch_pcint(uint8_t g) {
+  uint8_t x, c, b, i;
+  uint16_t lo, hi, ep;
+  uint32_t t, dt;
+  lo = TCNT1;
+  x = IOREG(PIN_0, pgm_read_byte(&pcint_port[g]) - PORT_BGN_CH);
+  hi = t1_ovf;
+  ep = t1_epoch;
+  if ((TIFR1 & _BV(TOV1)) && lo < 0x8000) {
+    if (++hi == 0) ep++;  // pending overflow
+  }
+  t = ((uint32_t)hi << 16) | lo;
+  c = (x ^ gl_last[g]) & _SFR_MEM8(_SFR_MEM_ADDR(PCMSK0) + g);
+  gl_last[g] = x;
+  if (c == 0) {
+    gl_fast++;
+    glitch_log(ep, t, 0xff, 0);
+    return;
+  }
+  for (b = 0; b < 8; b++) {
+    if (!(c & _BV(b))) continue;
+    i = (g << 3) | b;
+    gl_edges++;
+    dt = t - gl_edge[i];
+    gl_edge[i] = t;
+    if (dt < gl_width) {
+      if (gl_count[i] < 0xffff) gl_count[i]++;
+      glitch_log(ep, t, (pgm_read_byte(&pcint_port[g]) - PORT_BGN_CH) << 3 | b, dt);
+    }
+  }
+}
+
+ISR(PCINT0_vect) {
+  glitch_pcint(0);
+}
+#if PCINT_N > 1
+ISR(PCINT1_vect) {
+  glitch_pcint(1);
+}
+ISR(PCINT2_vect) {
+  glitch_pcint(2);
+}
+#endif
+
+// print TIMER1 clk/8 time as s.ms
+static void glitch_time(uint16_t ep, uint32_t t) {
+  uint64_t u = ((uint64_t)ep << 32) | t;
+  print_dec(u / GL_TPS);
+  u = (u % GL_TPS) * 1000 / GL_TPS;
+  print_c('.');
+  print_c('0' + u / 100);
+  print_c('0' + u / 10 % 10);
+  print_c('0' + u % 10);
+}
+
+// print a glitch width in 1/10 us
+static void glitch_width(uint16_t w) {
+  uint32_t u = (uint32_t)w * 10 / (GL_TPS / 1000000UL);
+  print_dec(u / 10);
+  print_c('.');
+  print_c('0' + u % 10);
+}
+
+void glitch_status(void) {
+  struct glitch e;
+  uint32_t edges, total, fast, t;
+  uint16_t ep, lo, hi;
+  uint8_t g, b, i, k;
+  if (!gl_on) {
+    print_sP(PSTR("GLITCH COUNTER OFF (GC to start)\n"));
+    return;
+  }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    edges = gl_edges;
+    total = gl_total;
+    fast = gl_fast;
+    lo = TCNT1;
+    hi = t1_ovf;
+    ep = t1_epoch;
+    if ((TIFR1 & _BV(TOV1)) && lo < 0x8000) {
+      if (++hi == 0) ep++;
+    }
+  }
+  t = ((uint32_t)hi << 16) | lo;
+  print_sP(PSTR("GLITCH < "));
+  glitch_width(gl_width);
+  print_sP(PSTR(" us: TOTAL="));
+  print_dec(total);
+  print_sP(PSTR(" FAST="));
+  print_dec(fast);
+  print_sP(PSTR(" EDGES="));
+  print_dec(edges);
+  print_sP(PSTR(" TIME="));
+  glitch_time(ep, t);
+  print_sP(PSTR(" s\n"));
+  for (g = 0; g < PCINT_N; g++) {
+    for (b = 0; b < 8; b++) {
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        lo = gl_count[(g << 3) | b];
+      }
+      if (lo == 0) continue;
+      print_sP(PSTR("  "));
+      print_c(pgm_read_byte(&pcint_port[g]));
+      print_c('0' + b);
+      print_sP(PSTR(": "));
+      print_hex4(lo);
+      print_crlf();
+    }
+  }
+  // latest first
+  k = (total < GL_RING) ? total : GL_RING;
+  for (i = 1; i <= k; i++) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      e = gl_ring[(gl_head + GL_RING - i) % GL_RING];
+    }
+    print_sP(PSTR("  "));
+    glitch_time(e.ep, e.t);
+    print_sP(PSTR(" s "));
+    if (e.pin == 0xff) {
+      print_sP(PSTR("?? < ISR latency\n"));
+      continue;
+    }
+    print_c(PORT_BGN_CH + (e.pin >> 3));
+    print_c('0' + (e.pin & 7));
+    print_c(' ');
+    glitch_width(e.w);
+    print_sP(PSTR(" us\n"));
+  }
+}
+
+void glitch_stop(void) {
+  uint8_t g;
+  if (!gl_on) return;
+  glitch_status();
+  PCICR &= ~((1 << PCINT_N) - 1);
+  for (g = 0; g < PCINT_N; g++) {
+    _SFR_MEM8(_SFR_MEM_ADDR(PCMSK0) + g) = 0;
+  }
+  TCCR1B = 0;
+  TIMSK1 &= ~_BV(TOIE1);
+  timer_release(1);
+  gl_on = 0;
+  print_sP(PSTR("GLITCH COUNTER STOPPED\n"));
+}
+
+void glitch_start(uint8_t us) {
+  uint8_t g, k, m, any = 0;
+  if (gl_on) {
+    print_sP(PSTR("E: GLITCH COUNTER running (GX to stop)\n"));
+    return;
+  }
+  if (!t1_start(_BV(CS11))) return;  // clk/8
+  timer_take(1);
+  if (us == 0) us = 0x0a;
+  gl_width = us * (GL_TPS / 1000000UL);
+  gl_edges = 0;
+  gl_total = 0;
+  gl_fast = 0;
+  gl_head = 0;
+  memset(gl_count, 0, sizeof(gl_count));
+  memset(gl_edge, 0, sizeof(gl_edge));
+  print_sP(PSTR("GLITCH COUNTER on"));
+  for (g = 0; g < PCINT_N; g++) {
+    k = pgm_read_byte(&pcint_port[g]) - PORT_BGN_CH;
+    m = mask[k] & ~IOREG(DDR_0, k);  // active inputs
+    m &= ~pgm_read_byte(&pcint_skip[g]);  // not the console
+    _SFR_MEM8(_SFR_MEM_ADDR(PCMSK0) + g) = m;
+    gl_last[g] = IOREG(PIN_0, k);
+    if (m) {
+      any |= _BV(g);
+      print_c(' ');
+      print_c(PORT_BGN_CH + k);
+      print_c(':');
+      print_bin8(m, 0xff);
+    }
+  }
+  if (!any) {
+    print_sP(PSTR(" none\nE: no active INPUT on PCINT ports\n"));
+    TCCR1B = 0;
+    TIMSK1 &= ~_BV(TOIE1);
+    timer_release(1);
+    return;
+  }
+  gl_on = 1;
+  PCIFR = any;
+  PCICR |= any;
+  print_sP(PSTR(" < "));
+  print_hex2(us);
+  print_sP(PSTR(" us (GS: status, GX: stop)\n"));
+}
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // I/O Memory access (HW general)
@@ -1038,18 +2479,585 @@ static void print_hexdump(uint16_t a0, uint16_t a1,
   }
 }
 //
-// Display
+// I2C master on the TWI hardware (polled, with timeouts)
 //
-static void display_digital(void) {
-  uint8_t i;
-  print_sP(PSTR("SRAM: *0x"));
-  print_hex4(str2word("."));
-  print_sP(PSTR(",  "));
-  print_sP(PSTR("FLASH: *0x"));
-  print_hex4(str2word(">"));
-  print_crlf();
-  bit_pin("?", NULL);
-  print_sP(PSTR(">>>>>>  state of mask and digital I/O ports  <<<<<<\n"));
+// IA sets the device address, IR/IW read/write a register block with a
+// repeated start.  Read data are kept in data[] as bytes for the dump.
+//
+#define TWI_SIZE 0x100   // max bytes of a block read
+static uint16_t twi_khz = 0x64;  // SCL clock (kHz)
+static uint8_t twi_addr = 0x50;  // 7 bit device address
+static uint8_t twi_reg;          // register of the first byte read
+
+static uint8_t twi_wait(void) {
+  uint16_t n = 0;
+  while (!(TWCR & _BV(TWINT))) {
+    if (++n == 0) return 0xff;  // timeout
+  }
+  return TW_STATUS;
+}
+
+static uint8_t twi_start(void) {
+  TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN);
+  return twi_wait();
+}
+
+static uint8_t twi_write(uint8_t b) {
+  TWDR = b;
+  TWCR = _BV(TWINT) | _BV(TWEN);
+  return twi_wait();
+}
+
+// read a byte into *b, return the status (TW_MR_DATA_ACK/NACK if good)
+static uint8_t twi_read(uint8_t ack, uint8_t *b) {
+  uint8_t st;
+  TWCR = _BV(TWINT) | _BV(TWEN) | (ack ? _BV(TWEA) : 0);
+  st = twi_wait();
+  *b = TWDR;
+  return st;
+}
+
+static void twi_stop(void) {
+  uint16_t n = 0;
+  TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+  while (TWCR & _BV(TWSTO)) {
+    if (++n == 0) break;
+  }
+}
+
+// set up TWI for twi_khz
+static void twi_init(void) {
+  uint32_t f = (uint32_t)twi_khz * 1000;
+  uint16_t b;
+  uint8_t ps;
+  TWI_PULLUP;
+  // SCL = F_CPU / (16 + 2 * TWBR * 4^TWPS)
+  for (ps = 0; ps < 4; ps++) {
+    b = (F_CPU / f - 16) / (2 << (2 * ps));
+    if (b < 0x100) break;
+  }
+  if (ps == 4) {
+    ps = 3;
+    b = 0xff;
+  }
+  TWBR = b;
+  TWSR = ps;
+  TWCR = _BV(TWEN);
+}
+
+static void twi_error(PGM_P s, uint8_t st) {
+  twi_stop();
+  print_sP(PSTR("E: I2C "));
+  print_sP(s);
+  print_sP(PSTR(" (TWSR=0x"));
+  print_hex2(st);
+  print_sP((st == 0xff) ? PSTR(" timeout)\n") : PSTR(")\n"));
+}
+
+void twi_clock(uint16_t khz) {
+  uint8_t ps;
+  if (khz) twi_khz = (khz > 0x190) ? 0x190 : khz;  // up to 400 kHz
+  twi_init();
+  ps = TWSR & 0x03;
+  print_sP(PSTR("I2C SCL = "));
+  print_dec(F_CPU / (16 + 2 * (uint32_t)TWBR * (1 << (2 * ps))));
+  print_sP(PSTR(" Hz " TWI_PINS "\n"));
+}
+
+void twi_address(char *addr) {
+  if (addr != NULL && *addr != '\0') twi_addr = str2byte(addr) & 0x7f;
+  print_sP(PSTR("I2C device = 0x"));
+  print_hex2(twi_addr);
+  print_crlf();
+}
+
+void twi_scan(void) {
+  uint8_t a, st, n = 0;
+  twi_init();
+  print_sP(PSTR("    0  1  2  3  4  5  6  7  8  9  a  b  c  d  e  f\n"));
+  for (a = 0; a < 0x80; a++) {
+    if ((a & 0x0f) == 0) {
+      print_hex2(a);
+      print_c(':');
+    }
+    if (a < 0x08 || a > 0x77) {
+      print_sP(PSTR("   "));  // reserved
+    } else {
+      st = twi_start();
+      if (st != TW_START) {
+        twi_error(PSTR("bus busy (SDA/SCL held low?)"), st);
+        return;
+      }
+      st = twi_write(a << 1 | TW_WRITE);
+      twi_stop();
+      if (st == TW_MT_SLA_ACK) {
+        print_c(' ');
+        print_hex2(a);
+        n++;
+      } else {
+        print_sP(PSTR(" --"));
+      }
+    }
+    if ((a & 0x0f) == 0x0f) print_crlf();
+  }
+  print_sP(PSTR("I2C FOUND "));
+  print_hex2(n);
+  print_crlf();
+}
+
+// start and send the register address, return 0 on error
+static uint8_t twi_begin(uint8_t reg) {
+  uint8_t st;
+  twi_init();
+  st = twi_start();
+  if (st != TW_START) {
+    twi_error(PSTR("bus busy"), st);
+    return 0;
+  }
+  st = twi_write(twi_addr << 1 | TW_WRITE);
+  if (st != TW_MT_SLA_ACK) {
+    twi_error(PSTR("no ACK from device"), st);
+    return 0;
+  }
+  st = twi_write(reg);
+  if (st != TW_MT_DATA_ACK) {
+    twi_error(PSTR("no ACK for register"), st);
+    return 0;
+  }
+  return 1;
+}
+
+static uint8_t read_twi_buf(uint16_t addr) {
+  return ((uint8_t *)(data + 1))[(uint8_t)(addr - twi_reg)];
+}
+
+void twi_read_block(char *reg, uint16_t n) {
+  uint8_t r = str2byte(reg);
+  uint8_t *buf = (uint8_t *)(data + 1);
+  uint8_t st;
+  uint16_t i;
+  if (n == 0) n = 0x10;
+  if (n > TWI_SIZE) n = TWI_SIZE;
+  if (!twi_begin(r)) return;
+  st = twi_start();  // repeated start
+  if (st != TW_REP_START) {
+    twi_error(PSTR("repeated start"), st);
+    return;
+  }
+  st = twi_write(twi_addr << 1 | TW_READ);
+  if (st != TW_MR_SLA_ACK) {
+    twi_error(PSTR("no ACK for read"), st);
+    return;
+  }
+  data[0] = 0xffff;  // data[] holds no record
+  for (i = 0; i < n; i++) {
+    st = twi_read(i < n - 1, &buf[i]);
+    if (st != ((i < n - 1) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK)) {
+      twi_error(PSTR("read data"), st);
+      return;
+    }
+  }
+  twi_stop();
+  twi_reg = r;
+  print_hexdump(r, r + n - 1, &read_twi_buf);
+}
+
+void twi_write_block(char *reg, char *val) {
+  uint8_t r = str2byte(reg);
+  uint8_t st;
+  uint8_t n = 0;
+  char buf[3]; // buffer to parse 2 hex chars
+  if (!twi_begin(r)) return;
+  while ((val != NULL) && (val[0] != '\0')) {
+    buf[0] = *val++;
+    buf[1] = (*val != '\0') ? *val++ : '\0';
+    buf[2] = '\0';
+    st = twi_write(str2byte(buf));
+    if (st != TW_MT_DATA_ACK) {
+      twi_error(PSTR("no ACK for data"), st);
+      return;
+    }
+    n++;
+  }
+  twi_stop();
+  print_sP(PSTR("I2C WROTE "));
+  print_hex2(n);
+  print_sP(PSTR(" bytes\n"));
+}
+
+//
+// SPI master on the SPI hardware
+//
+// PX sends the hex bytes, then word more bytes of 0xff, back to back with
+// CS low, and prints all bytes received (kept in data[] as bytes).
+//
+static const uint8_t spi_clk[] PROGMEM = {
+  // SPI2X << 2 | SPR1:0 for clk/2 ... clk/128
+  0x04, 0x00, 0x05, 0x01, 0x06, 0x02, 0x03
+};
+static uint8_t spi_mode = 0;            // CPOL << 1 | CPHA
+static uint8_t spi_div = 2;             // clk/2^spi_div
+static uint8_t spi_cs_port = 'B' - PORT_BGN_CH;  // CS port index
+static uint8_t spi_cs_bit = SPI_SS;
+
+static void spi_init(void) {
+  uint8_t c = pgm_read_byte(&spi_clk[spi_div - 1]);
+  pix_wait();
+  PORTB |= _BV(SPI_SS);
+  DDRB |= _BV(SPI_SS) | _BV(SPI_MOSI) | _BV(SPI_SCK);  // SS output: master
+  DDRB &= ~_BV(SPI_MISO);
+  IOREG(PORT_0, spi_cs_port) |= _BV(spi_cs_bit);       // CS high
+  IOREG(DDR_0, spi_cs_port) |= _BV(spi_cs_bit);
+  SPCR = _BV(SPE) | _BV(MSTR) | (spi_mode << CPHA) | (c & 0x03);
+  SPSR = (c & 0x04) ? _BV(SPI2X) : 0;
+}
+
+static void spi_report(void) {
+  print_sP(PSTR("SPI mode="));
+  print_hex1(spi_mode);
+  print_sP(PSTR(" clk/"));
+  print_hex2(1 << spi_div);
+  print_sP(PSTR(" ("));
+  print_dec(F_CPU >> spi_div);
+  print_sP(PSTR(" Hz) CS="));
+  print_c(PORT_BGN_CH + spi_cs_port);
+  print_c('0' + spi_cs_bit);
+  print_sP(PSTR(" " SPI_PINS "\n"));
+}
+
+void spi_set_mode(char *val) {
+  if (val != NULL && *val != '\0') spi_mode = str2byte(val) & 3;
+  spi_report();
+}
+
+void spi_set_div(char *val) {
+  uint8_t d;
+  if (val != NULL && *val != '\0') {
+    d = str2byte(val);
+    for (spi_div = 1; spi_div < 7 && (2 << spi_div) <= d; spi_div++) ;
+  }
+  spi_report();
+}
+
+// CS pin with the bit_pin() syntax: "B2" etc.
+void spi_set_cs(char *pin) {
+  if (pin != NULL && pin[0] >= PORT_BGN_CH && pin[0] <= PORT_END_CH &&
+      pin[1] >= '0' && pin[1] <= '7') {
+    IOREG(PORT_0, spi_cs_port) |= _BV(spi_cs_bit);  // release the old CS
+    spi_cs_port = pin[0] - PORT_BGN_CH;
+    spi_cs_bit = pin[1] - '0';
+  } else if (pin != NULL && *pin != '\0' && *pin != '?') {
+    print_sP(PSTR("\nInvalid pin: "));
+    print_s(pin);
+    print_crlf();
+  }
+  spi_init();
+  spi_report();
+}
+
+static uint8_t read_spi_buf(uint16_t addr) {
+  return ((uint8_t *)(data + 1))[addr];
+}
+
+void spi_xfer(char *val, uint16_t n) {
+  uint8_t *buf = (uint8_t *)(data + 1);
+  uint16_t i, m = 0;
+  uint16_t t = 0;
+  uint8_t timed;
+  char b[3]; // buffer to parse 2 hex chars
+  while ((val != NULL) && (val[0] != '\0') && m < 2 * (DATASIZE - 1)) {
+    b[0] = *val++;
+    b[1] = (*val != '\0') ? *val++ : '\0';
+    b[2] = '\0';
+    buf[m++] = str2byte(b);
+  }
+  if (n > 2 * (DATASIZE - 1) - m) n = 2 * (DATASIZE - 1) - m;
+  for (i = 0; i < n; i++) buf[m + i] = 0xff;
+  n += m;
+  data[0] = 0xffff;  // data[] holds no record
+  if (n == 0) return;
+  spi_init();
+  timed = !(timer_busy & _BV(1));
+  if (timed) {
+    t1_uses++;
+    TCCR1A = 0;
+    TCCR1B = 0;
+    TCNT1 = 0;
+    TCCR1B = _BV(CS11) | _BV(CS10);  // clk/64
+  }
+  IOREG(PORT_0, spi_cs_port) &= ~_BV(spi_cs_bit);  // CS low
+  for (i = 0; i < n; i++) {
+    SPDR = buf[i];
+    while (!(SPSR & _BV(SPIF))) ;
+    buf[i] = SPDR;
+  }
+  IOREG(PORT_0, spi_cs_port) |= _BV(spi_cs_bit);   // CS high
+  if (timed) {
+    t = TCNT1;
+    TCCR1B = 0;
+  }
+  print_hexdump(0, n - 1, &read_spi_buf);
+  print_sP(PSTR("SPI "));
+  print_hex4(n);
+  print_sP(PSTR(" bytes"));
+  if (timed) {
+    print_sP(PSTR(" in "));
+    print_dec((uint32_t)t * 64 / (F_CPU / 1000000UL));
+    print_sP(PSTR(" us"));
+  }
+  print_crlf();
+}
+
+//
+// Single line sampler: the SPI hardware in slave mode shifts in the MOSI
+// line on a SCK generated by TIMER1 on OC1A (CTC toggle), so one byte of
+// data[] holds 8 evenly spaced samples (up to F_CPU/6, 2.67 MS/s: the
+// SPI slave needs SCK high and low for more than 2 clk, so OCR1A >= 2)
+//
+// External wiring: SPICAP_PINS.  Interrupts are off at high rates.
+//
+
+// sample MOSI at khz kHz, start on a MOSI edge if trig
+void spi_sample(uint16_t khz, uint8_t trig) {
+  uint8_t *p = (uint8_t *)(data + 2);
+  uint8_t *end = (uint8_t *)(data + DATASIZE);
+  uint8_t x0, idle = 0;
+  uint8_t sreg;
+  uint16_t ocr, w;
+  if (!timer_free(1)) return;
+  if (khz == 0) khz = F_CPU / 6000;
+  ocr = F_CPU / 2000 / khz;
+  ocr = (ocr > 3) ? ocr - 1 : 2;
+  pix_wait();
+  data[0] = 0xffff;  // data[] holds no record
+  DDRB &= ~(_BV(SPI_SS) | _BV(SPI_SCK) | _BV(SPI_MOSI) | _BV(SPI_MISO));
+  if (PINB & _BV(SPI_SS)) {
+    print_sP(PSTR("E: SS is high, wire " SPICAP_PINS "\n"));
+    return;
+  }
+  // OC1A low: clear on a forced compare, then toggle on compare match
+  t1_uses++;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  OCR1A = ocr;
+  TCCR1A = _BV(COM1A1);
+  TCCR1C = _BV(FOC1A);
+  TCCR1A = _BV(COM1A0);
+  DDRB |= _BV(SPICAP_OC1A);
+  SPCR = 0;
+  SPCR = _BV(SPE);  // slave, mode 0: sample on the SCK rising edge
+  (void)SPSR;
+  (void)SPDR;       // clear SPIF
+  print_sP(PSTR("SAMPLE "));
+  print_dec(F_CPU / 2 / (ocr + 1));
+  print_sP(PSTR(" Hz MOSI"));
+  if (trig) {
+    print_sP(PSTR(", waiting for an edge (any key to stop)\n"));
+    x0 = PINB & _BV(SPI_MOSI);
+    while ((PINB & _BV(SPI_MOSI)) == x0) {
+      if (++idle == 0 && check_input()) goto done;
+    }
+  } else {
+    print_crlf();
+  }
+  sreg = SREG;
+  if (ocr < 0x40) cli();  // a byte in less than 0x400 clk
+  TCCR1B = _BV(WGM12) | _BV(CS10);  // CTC, clk/1
+  while (p < end) {
+    w = 0xffff;  // timeout count
+    while (!(SPSR & _BV(SPIF))) {
+      if (--w == 0) break;
+    }
+    if (w == 0) break;
+    *p++ = SPDR;
+  }
+  SREG = sreg;
+  if (p < end) print_sP(PSTR("E: no SCK, wire " SPICAP_PINS "\n"));
+done:
+  TCCR1B = 0;
+  TCCR1A = 0;
+  DDRB &= ~_BV(SPICAP_OC1A);
+  SPCR = 0;
+  if (p < end) return;
+  data[0] = 0x5a00;
+  data[1] = ocr;
+  spi_sample_dump();
+}
+
+//
+// Passive bus sniffers: decode into the data[] event log until a key is
+// pressed or data[] is full
+//
+// I2C and UART are sampled by a polling loop (I2C up to 100 kHz), SPI by
+// the SPI hardware in slave mode (MISO stays an input).
+//
+static uint16_t sniff_i;  // next data[] index
+
+static void sniff_begin(uint8_t mode, PGM_P s) {
+  data[0] = 0x5e00 | mode;
+  data[1] = 0xffff;
+  sniff_i = 1;
+  print_sP(PSTR("SNIFF "));
+  print_sP(s);
+  print_sP(PSTR(" START (any key to stop)\n"));
+}
+
+// log an event, return 0 if data[] is full
+static uint8_t sniff_log(uint8_t e, uint8_t v) {
+  data[sniff_i++] = (e << 8) | v;
+  data[sniff_i] = 0xffff;
+  return sniff_i < DATASIZE - 1;
+}
+
+static void sniff_end(void) {
+  print_sP(PSTR("SNIFF END "));
+  print_hex4(sniff_i - 1);
+  print_sP(PSTR(" events\n"));
+  sniff_dump();
+}
+
+void sniff_i2c(void) {
+  uint8_t x, x0;      // SCL, SDA now and before
+  uint8_t b = 0;      // bits of the byte (9th: ACK)
+  uint8_t v = 0;      // byte
+  uint8_t f = 0;      // 0: idle, 1: address byte next, 2: data byte next
+  uint8_t idle = 0;
+  const uint8_t scl = _BV(TWI_SCL);
+  const uint8_t sda = _BV(TWI_SDA);
+  TWCR = 0;  // TWI off, SDA and SCL as plain inputs
+  sniff_begin(SNIFF_I2C, PSTR("I2C " TWI_PINS));
+  x0 = TWI_PINR & (scl | sda);
+  for (;;) {
+    x = TWI_PINR & (scl | sda);
+    if (x == x0) {
+      // any bus state: a lost STOP or a stuck line must not lock up
+      if (++idle == 0 && check_input()) break;
+      continue;
+    }
+    if ((x & x0 & scl) && ((x ^ x0) & sda)) {
+      // SDA changed while SCL high
+      if (x & sda) {
+        f = 0;
+        if (!sniff_log(EV_STOP, 0)) break;
+      } else {
+        f = 1;
+        b = 0;
+        if (!sniff_log(EV_START, 0)) break;
+      }
+    } else if (f && (x & ~x0 & scl)) {
+      // SCL rising: sample SDA
+      if (b < 8) {
+        v = (v << 1) | ((x & sda) ? 1 : 0);
+        b++;
+      } else {
+        if (!sniff_log((f == 1) ? ((x & sda) ? EV_ADDRN : EV_ADDR)
+                                : ((x & sda) ? EV_NACK : EV_ACK), v)) break;
+        f = 2;
+        b = 0;
+      }
+    }
+    x0 = x;
+  }
+  sniff_end();
+}
+
+void sniff_spi(uint8_t mode) {
+  uint8_t x, x0;      // SS now and before
+  uint8_t idle = 0;
+  pix_wait();
+  DDRB &= ~(_BV(SPI_SS) | _BV(SPI_SCK) | _BV(SPI_MOSI) | _BV(SPI_MISO));
+  SPCR = 0;
+  SPCR = _BV(SPE) | ((mode & 3) << CPHA);  // slave, CPOL and CPHA
+  (void)SPSR;
+  (void)SPDR;  // clear SPIF
+  sniff_begin(SNIFF_SPI, PSTR("SPI MOSI " SPI_PINS));
+  x0 = PINB & _BV(SPI_SS);
+  for (;;) {
+    if (SPSR & _BV(SPIF)) {
+      if (!sniff_log(EV_ACK, SPDR)) break;
+    }
+    x = PINB & _BV(SPI_SS);
+    if (x != x0) {
+      // SS edge: bytes are done before SS goes high
+      if (x && (SPSR & _BV(SPIF))) {
+        if (!sniff_log(EV_ACK, SPDR)) break;
+      }
+      if (!sniff_log(x ? EV_CSX : EV_CS, 0)) break;
+      x0 = x;
+    } else if (++idle == 0 && check_input()) {
+      break;  // also with SS held low
+    }
+  }
+  SPCR = 0;
+  sniff_end();
+}
+
+void sniff_uart(uint16_t baud) {
+  uint16_t bt;        // bit time in TIMER1 ticks
+  uint16_t t;         // next sample
+  uint8_t i, v;
+  uint8_t idle = 0;
+  uint8_t cs = _BV(CS10);
+  if (!timer_free(1)) return;
+  if (baud == 0) baud = 0x2580;  // 9600
+  // the first wait (1.5 bit times) must fit the int16_t compare
+  if (F_CPU / baud * 3 / 2 > 0x7fff) {
+    if (F_CPU / 8 / baud * 3 / 2 > 0x7fff) {
+      print_sP(PSTR("E: baud too low (min "));
+      print_dec(F_CPU / 8 * 3 / 2 / 0x7fff + 1);
+      print_sP(PSTR(")\n"));
+      return;
+    }
+    cs = _BV(CS11);  // clk/8
+    bt = F_CPU / 8 / baud;
+  } else {
+    bt = F_CPU / baud;
+  }
+  sniff_begin(SNIFF_UART, PSTR("UART RX on BIT pin"));
+  t1_uses++;
+  TCCR1A = 0;
+  TCCR1B = cs;
+  for (;;) {
+    // wait for the start bit
+    while (*gpio_pinr & gpio_mask) {
+      if (++idle == 0 && check_input()) goto done;
+    }
+    t = TCNT1 + bt + bt / 2;  // middle of bit 0
+    v = 0;
+    for (i = 0; i < 8; i++) {
+      while ((int16_t)(TCNT1 - t) < 0) ;
+      v >>= 1;
+      if (*gpio_pinr & gpio_mask) v |= 0x80;
+      t += bt;
+    }
+    while ((int16_t)(TCNT1 - t) < 0) ;
+    if (*gpio_pinr & gpio_mask) {
+      if (!sniff_log(EV_ACK, v)) break;
+    } else {
+      if (!sniff_log(EV_FERR, v)) break;
+      while (!(*gpio_pinr & gpio_mask)) {
+        if (++idle == 0 && check_input()) goto done;  // break condition
+      }
+    }
+  }
+done:
+  TCCR1B = 0;
+  sniff_end();
+}
+
+//
+// Display
+//
+static void display_digital(void) {
+  uint8_t i;
+  print_sP(PSTR("SRAM: *0x"));
+  print_hex4(str2word("."));
+  print_sP(PSTR(",  "));
+  print_sP(PSTR("FLASH: *0x"));
+  print_hex4(str2word(">"));
+  print_crlf();
+  bit_pin("?", NULL);
+  print_sP(PSTR(">>>>>>  state of mask and digital I/O ports  <<<<<<\n"));
   print_sP(PSTR("MASK:   "));
   for (i = 0; i < N_PORTS; i++) {
     print_c(PORT_BGN_CH + i);
@@ -1174,6 +3182,344 @@ void mask_enabled_for_display(void) {
   mask_override = 0; // enable mask for display
   print_sP(PSTR("Mask ENabled for display\n"));
 }
+//
+// Continuity scan: walking-zero and walking-one over active OUTPUT pins
+//
+// For each active output j, all other active outputs are driven to the
+// opposite level and all pins are read back.  An active input follows j
+// in both passes if it is wired to j (inputs are pulled up for the scan),
+// and an active output that does not read its own level is shorted to j.
+// Results of repeated passes are kept in data[] as 2 * N_PORTS bytes per
+// output: pins seen in any pass and pins seen in all passes.
+//
+#define SCAN_SETTLE_US 5  // settling time after each step
+
+static void scan_pin(uint8_t i, uint8_t b) {
+  print_c(PORT_BGN_CH + i);
+  print_c('0' + b);
+}
+
+static void scan_drive(uint8_t *out, uint8_t i, uint8_t b, uint8_t level) {
+  uint8_t k;
+  for (k = 0; k < N_PORTS; k++) {
+    if (level) {
+      IOREG(PORT_0, k) &= ~out[k];
+    } else {
+      IOREG(PORT_0, k) |= out[k];
+    }
+  }
+  if (level) {
+    IOREG(PORT_0, i) |= _BV(b);
+  } else {
+    IOREG(PORT_0, i) &= ~_BV(b);
+  }
+  _delay_us(SCAN_SETTLE_US);
+}
+
+void scan_continuity(uint16_t passes) {
+  uint8_t out[N_PORTS];   // active outputs
+  uint8_t in[N_PORTS];    // active inputs
+  uint8_t port[N_PORTS];  // saved PORTx
+  uint8_t r0[N_PORTS];    // walking-zero read back
+  uint8_t r1;             // walking-one read back
+  uint8_t *m = (uint8_t *)(data + 1);  // [any, all] per output
+  uint8_t *mm;
+  uint8_t i, b, k, c, n;
+  uint8_t mcucr;
+  uint16_t p;
+  if (passes == 0) passes = 1;
+  data[0] = 0xffff;  // data[] holds no record
+  n = 0;
+  for (k = 0; k < N_PORTS; k++) {
+    out[k] = mask[k] & IOREG(DDR_0, k);
+    in[k] = mask[k] & ~IOREG(DDR_0, k);
+    port[k] = IOREG(PORT_0, k);
+    for (b = 0; b < 8; b++) {
+      if (out[k] & _BV(b)) n++;
+    }
+  }
+  if (n == 0) {
+    print_sP(PSTR("E: no active OUTPUT (SK to set)\n"));
+    return;
+  }
+  for (p = 0; p < (uint16_t)n * 2 * N_PORTS; p++) {
+    m[p] = (p % (2 * N_PORTS) < N_PORTS) ? 0x00 : 0xff;
+  }
+  // inputs pulled up during the scan
+  mcucr = MCUCR;
+  MCUCR &= ~_BV(PUD);
+  for (k = 0; k < N_PORTS; k++) {
+    IOREG(PORT_0, k) |= in[k];
+  }
+  for (p = 0; p < passes; p++) {
+    mm = m;
+    for (i = 0; i < N_PORTS; i++) {
+      for (b = 0; b < 8; b++) {
+        if (!(out[i] & _BV(b))) continue;
+        scan_drive(out, i, b, 0);  // walking-zero
+        for (k = 0; k < N_PORTS; k++) r0[k] = IOREG(PIN_0, k);
+        scan_drive(out, i, b, 1);  // walking-one
+        for (k = 0; k < N_PORTS; k++) {
+          r1 = IOREG(PIN_0, k);
+          c = (~r0[k] & r1 & in[k]) | ((~r0[k] | r1) & out[k]);
+          if (k == i) {
+            c &= ~_BV(b);
+            if (!(~r0[k] & r1 & _BV(b))) c |= _BV(b);  // can't drive itself
+          }
+          mm[k] |= c;
+          mm[N_PORTS + k] &= c;
+        }
+        mm += 2 * N_PORTS;
+      }
+    }
+    if (check_input()) {
+      p++;
+      break;
+    }
+  }
+  for (k = 0; k < N_PORTS; k++) {
+    IOREG(PORT_0, k) = port[k];
+  }
+  MCUCR = mcucr;
+  // report
+  print_sP(PSTR("CONTINUITY SCAN PASSES="));
+  print_hex4(p);
+  print_sP(PSTR(" (pin: wired inputs, *: short, ~: intermittent)\n"));
+  mm = m;
+  for (i = 0; i < N_PORTS; i++) {
+    for (b = 0; b < 8; b++) {
+      if (!(out[i] & _BV(b))) continue;
+      scan_pin(i, b);
+      print_c(':');
+      c = 0;  // anything found
+      for (k = 0; k < N_PORTS; k++) {
+        for (n = 0; n < 8; n++) {
+          if (!(mm[k] & _BV(n))) continue;
+          c = 1;
+          print_c(' ');
+          if (!(mm[N_PORTS + k] & _BV(n))) print_c('~');
+          if (k == i && n == b) {
+            print_sP(PSTR("STUCK"));
+            continue;
+          }
+          scan_pin(k, n);
+          if (out[k] & _BV(n)) print_c('*');
+        }
+      }
+      if (!c) print_sP(PSTR(" OPEN"));
+      print_crlf();
+      mm += 2 * N_PORTS;
+    }
+  }
+}
+
+//
+// Keyboard matrix scan benchmark
+//
+// Active outputs are rows (driven low one at a time), active inputs are
+// columns (pulled up, a pressed key reads 0).  Each key is debounced
+// over tcount scans (BTS); its bounce time is the span from the first
+// change to the last change before the tcount stable scans.  A ghost is
+// 2 rows sharing 2 or more pressed columns (a rectangle of keys).
+//
+struct key_stat {
+  uint8_t cnt;    // stable scans since the last change
+  uint8_t n;      // presses
+  uint16_t t0;    // scan of the first change
+  uint16_t bmax;  // longest bounce (scans)
+};
+
+void scan_matrix(uint8_t settle) {
+  uint8_t out[N_PORTS];      // active outputs (rows)
+  uint8_t in[N_PORTS];       // active inputs (columns)
+  uint8_t port[N_PORTS];     // saved PORTx
+  uint8_t raw[N_PORTS];      // pressed keys of the row
+  uint8_t rp[8 * N_PORTS];   // row pins: port << 3 | bit
+  uint8_t ci[8 * N_PORTS];   // column index of port << 3 | bit
+  uint8_t gh[N_PORTS];       // columns of the last ghost
+  uint8_t gr0 = 0, gr1 = 0;  // rows of the last ghost
+  uint8_t *prev, *bnc, *stb; // per row: last raw, bouncing, debounced
+  struct key_stat *ks;
+  struct key_stat *kp;       // keys of the row
+  struct key_stat *p;
+  uint8_t nr, nc;            // # of rows, columns
+  uint8_t i, k, n, r, r2, d, bm, chg, m;
+  uint8_t ghost = 0;
+  uint8_t mcucr;
+  uint8_t db = tcount ? tcount : 1;
+  uint16_t s = 0;            // scan count (for bounce time)
+  uint16_t b;
+  uint16_t ng = 0;           // ghost events
+  uint32_t scans = 0;
+  uint32_t dt, p10;
+  nr = 0;
+  nc = 0;
+  for (k = 0; k < N_PORTS; k++) {
+    out[k] = mask[k] & IOREG(DDR_0, k);
+    in[k] = mask[k] & ~IOREG(DDR_0, k);
+    port[k] = IOREG(PORT_0, k);
+    for (n = 0; n < 8; n++) {
+      if (out[k] & _BV(n)) rp[nr++] = (k << 3) | n;
+      ci[(k << 3) | n] = (in[k] & _BV(n)) ? nc++ : 0xff;
+    }
+  }
+  if (nr == 0 || nc == 0) {
+    print_sP(PSTR("E: no active OUTPUT (row) or INPUT (column) (SK to set)\n"));
+    return;
+  }
+  if (3 * nr * N_PORTS + (uint16_t)nr * nc * sizeof(struct key_stat) > 2 * (DATASIZE - 1)) {
+    print_sP(PSTR("E: matrix too large for data[]\n"));
+    return;
+  }
+  if (!t1_start(T1_CLK1024)) return;
+  data[0] = 0xffff;  // data[] holds no record
+  prev = (uint8_t *)(data + 1);
+  bnc = prev + nr * N_PORTS;
+  stb = bnc + nr * N_PORTS;
+  ks = (struct key_stat *)(stb + nr * N_PORTS);
+  memset(prev, 0, 3 * nr * N_PORTS + (uint16_t)nr * nc * sizeof(struct key_stat));
+  print_sP(PSTR("KEY MATRIX SCAN START ROWS="));
+  print_hex2(nr);
+  print_sP(PSTR(" COLUMNS="));
+  print_hex2(nc);
+  print_crlf();
+  // rows high, columns pulled up
+  mcucr = MCUCR;
+  MCUCR &= ~_BV(PUD);
+  for (k = 0; k < N_PORTS; k++) {
+    IOREG(PORT_0, k) |= out[k] | in[k];
+  }
+  do {
+    chg = 0;
+    for (r = 0; r < nr; r++) {
+      i = rp[r] >> 3;
+      bm = _BV(rp[r] & 7);
+      IOREG(PORT_0, i) &= ~bm;
+      for (d = settle; d; d--) _delay_us(1);
+      for (k = 0; k < N_PORTS; k++) raw[k] = ~IOREG(PIN_0, k) & in[k];
+      IOREG(PORT_0, i) |= bm;
+      kp = ks + (uint16_t)r * nc;
+      for (k = 0; k < N_PORTS; k++) {
+        m = raw[k] ^ prev[k];
+        d = m | bnc[k];
+        if (!d) continue;
+        for (n = 0; n < 8; n++) {
+          bm = _BV(n);
+          if (!(d & bm)) continue;
+          p = kp + ci[(k << 3) | n];
+          if (m & bm) {
+            p->cnt = 0;
+            if (!(bnc[k] & bm)) {
+              bnc[k] |= bm;
+              p->t0 = s;
+            }
+          } else if (++p->cnt >= db) {
+            bnc[k] &= ~bm;
+            b = s - db - p->t0;
+            if (b > p->bmax) p->bmax = b;
+            if ((raw[k] ^ stb[k]) & bm) {
+              stb[k] ^= bm;
+              chg = 1;
+              if ((raw[k] & bm) && p->n < 0xff) p->n++;
+            }
+          }
+        }
+        prev[k] = raw[k];
+      }
+      prev += N_PORTS;
+      bnc += N_PORTS;
+      stb += N_PORTS;
+    }
+    prev -= nr * N_PORTS;
+    bnc -= nr * N_PORTS;
+    stb -= nr * N_PORTS;
+    if (chg) {
+      chg = ghost;
+      ghost = 0;
+      for (r = 0; r < nr && !ghost; r++) {
+        for (r2 = r + 1; r2 < nr && !ghost; r2++) {
+          m = 0;
+          for (k = 0; k < N_PORTS; k++) {
+            d = stb[r * N_PORTS + k] & stb[r2 * N_PORTS + k];
+            if (d) m += (d & (d - 1)) ? 2 : 1;
+          }
+          if (m >= 2) {
+            ghost = 1;
+            gr0 = r;
+            gr1 = r2;
+            for (k = 0; k < N_PORTS; k++) {
+              gh[k] = stb[r * N_PORTS + k] & stb[r2 * N_PORTS + k];
+            }
+          }
+        }
+      }
+      if (ghost && !chg) ng++;  // new ghost
+    }
+    s++;
+    scans++;
+  } while ((s & 0xff) || !check_input());
+  dt = t1_time();
+  for (k = 0; k < N_PORTS; k++) {
+    IOREG(PORT_0, k) = port[k];
+  }
+  MCUCR = mcucr;
+  t1_stop();
+  // scan rate: keep scans * T1_TPS in 32 bit
+  print_sP(PSTR(" SCANS="));
+  print_dec(scans);
+  while (scans > 0xffff) {
+    scans >>= 1;
+    dt >>= 1;
+  }
+  if (dt == 0) dt = 1;
+  print_sP(PSTR(" RATE="));
+  print_dec(scans * T1_TPS / dt);
+  print_sP(PSTR(" Hz PERIOD="));
+  p10 = (dt / scans) * (10000000UL / T1_TPS) +
+        (dt % scans) * (10000000UL / T1_TPS) / scans;  // 1/10 us
+  print_dec(p10 / 10);
+  print_c('.');
+  print_c('0' + p10 % 10);
+  print_sP(PSTR(" us\n"));
+  // keys with activity
+  for (r = 0; r < nr; r++) {
+    for (k = 0; k < N_PORTS; k++) {
+      for (n = 0; n < 8; n++) {
+        if (!(in[k] & _BV(n))) continue;
+        kp = ks + (uint16_t)r * nc + ci[(k << 3) | n];
+        if (kp->n == 0 && kp->bmax == 0) continue;
+        scan_pin(rp[r] >> 3, rp[r] & 7);
+        print_c('-');
+        scan_pin(k, n);
+        print_sP(PSTR(": PRESS="));
+        print_hex2(kp->n);
+        print_sP(PSTR(" BOUNCE="));
+        print_hex4(kp->bmax);
+        print_sP(PSTR(" scans "));
+        print_dec((uint32_t)kp->bmax * (p10 / 10) + (uint32_t)kp->bmax * (p10 % 10) / 10);
+        print_sP(PSTR(" us\n"));
+      }
+    }
+  }
+  print_sP(PSTR("GHOST="));
+  print_hex4(ng);
+  if (ng) {
+    print_sP(PSTR(" last: rows "));
+    scan_pin(rp[gr0] >> 3, rp[gr0] & 7);
+    print_c(' ');
+    scan_pin(rp[gr1] >> 3, rp[gr1] & 7);
+    print_sP(PSTR(" columns"));
+    for (k = 0; k < N_PORTS; k++) {
+      for (n = 0; n < 8; n++) {
+        if (!(gh[k] & _BV(n))) continue;
+        print_c(' ');
+        scan_pin(k, n);
+      }
+    }
+  }
+  print_crlf();
+}
+
 //
 // Analog
 //
@@ -1185,7 +3531,7 @@ static void monitor_analog(void) {
   uint8_t i, j, k;
   uint16_t av;
   DIDR0 = 0x3f;  // Digital Input Disable
-  ADCSRA = _BV(ADEN);  // ADC Enable
+  ADCSRA |= _BV(ADEN);  // ADC Enable (keep ADPS set by AP)
   print_sP(PSTR("Analog Input Enabled.  Digital input disabled\n"));
   adps_set("?"); // ADC prescaler 1/128
   aref_set("?"); // VREF=Vcc
@@ -1262,441 +3608,1818 @@ static void monitor_analog(void) {
   }
 }
 
-#ifdef VERBOSE
-void display_help(void) {
-  print_sP(PSTR(
-"===== Command syntax =====\n"
-"a1 a2     a3    action        / variant commands\n"
-"R  addr0  addr1 sram hexdump  / RA: sram alldump, RP: program hexdump\n"
-"W  addr   val   sram =write   / WA: sram &=write, WO: sram |=write\n"
-"D               PIN state     / DC: PIN state (changed **)\n"
-"S               Set initial   / SK: Set alternative, SM: Set MASK\n"
-"SMD             Set mask disabled for display / SME: Set mask enabled\n"
-"SOH             Set OUTPUT 1  / SOL: Set OUTPUT 0\n"
-"SIP             Set INPUT pull-up / SIP: Set tri-state, alias: SIH, SIL\n"
-"SPD             Set MCUCR PUD to disable pull-up / SPE: enable pull-up\n"
-
-"B               Toggle BIT (output), Triggered BIT read (input)\n"
-"B pin mode      Set a BIT to mode=OH/OL/IH/IL (" QS(LED_PIN) " OL), or '?','P'\n"
-"BL              BIT to 0 (low) / BH: BIT to 1 (high), BD: Dump recorded data\n"
-"BTS tspan tcount  Set time span and trigger count / BTU: Set unit in ms (5)\n"
-"BTX var1 var2   Set time unit for LED pixel driver (MCU loops) (5 15)\n"
-"BP [P]          Record pins around BIT pin (w/ P, print recorded data)\n"
-"BB word         Blink  BIT (unit 100 ms) (O) **\n"
-"BW var          PWM wave of BIT var=0 bright, var=3 50/50 (O)\n"
-"BX              Send LED data / BX ?: Print pixel LED dat\n"
-"BX color        Set pixel LED data FFFFFF-like or .R.G.B-like series\n"
-
-"A               Monitor analog inputs / AX: Analog input off\n"
-"AP para         Set analog prescaler　/ AP: Set analog prescaler\n"
-"? val           print 8 bit   / ??: 16 bit value (calculator)\n"
-"\n"
-"Numbers: hexadecimal / ~: bit flip, %....: binary, @...: mnemonic\n"
-"         '.' means sram next,  ',' means sram previous\n"
-"         '>' means flash next, '<' means flash previous\n"
-));
+//
+// Select ADC input multiplexer (MUX5:0 as listed in the data sheet)
+//
+static void adc_mux(uint8_t j) {
+#ifdef BOARD_nano
+  ADMUX = (ADMUX & 0b11110000) | (j & 0b01111);  // MUX3:0
+#endif
+#if defined BOARD_teensy2
+  ADMUX = (ADMUX & 0b11100000) | (j & 0b11111);  // MUX4:0
+  if (j & 0b100000) {
+    ADCSRB |= _BV(MUX5);
+  } else {
+    ADCSRB &= ~_BV(MUX5);
+  }
+#endif
+#if defined BOARD_teensy2pp
+  ADMUX = (ADMUX & 0b11100000) | (j & 0b11111);  // MUX4:0
+#endif
 }
-#endif // VERBOSE
-///////////////////////////////////////////////////////////////////////////
 //
-// System monitor
+// Capture n ADC samples in free running mode (13 ADC clocks / sample)
 //
-/////////////////////////////////////////////////////////////////////////////
-int main(void) {
-  // command line tokenizer for main loop (w/ history)
-  char s[BUFSIZE];               // line
-  char sx[BUFSIZE];              // lastline
-  char *str_main, *str_sub;                                 // str
-  char *token_main, *token_sub1, *token_sub2, *token_sub3;  // token
-  char *saveptr_main, *saveptr_sub;                         // saveptr
-  // byte value to set
-  uint8_t val = 0;
-  // sram pointer
-  addr_sram = 0x00;                 // start of SRAM
-  addr_sram_last = 0x00;            // start of SRAM (last)
-  uint16_t addr_sram_tmp;           // temp
-  uint16_t addr_sram_end = 0x00;    // same as start
-  uint16_t addr_sram_range = 0xff;  // range 256 bytes from 0
-  // program memory hexdump pointer
-  addr_flash = 0x00;                // start flash
-  addr_flash_last = 0x00;           // start
-  uint16_t addr_flash_tmp;          // temp
-  uint16_t addr_flash_end = 0xff;   // end
-  uint16_t addr_flash_range = 0xff; // range from 0
-  // LED data buffer
-  uint8_t pixled[LEDSIZE];
-  uint8_t ledlen; // 3 * (#LEDs)
-  // initialize MCU
-  CPU_PRESCALE;
-  // initialize USB
-  init_comm();
-  // opening messages
-  print_sP(PSTR("\nAVRmon v 0.2\n"));
-  print_sP(PSTR("  MCU   = " QS(MCU) "  F_CPU = " QS(F_CPU) "\n"));
-  print_sP(PSTR("  BOARD = " QS(BOARD) "     BAUD = " QS(BAUD) "\n"));
-  print_sP(PSTR("  GPL 2.0+, Copyright 2020 - 2021, <osamu@debian.org>\n\n"));
-  print_sP(PSTR("Commands are case insensitive.  'H' for more help.\n"));
-  print_sP(PSTR("Numbers are typed as binary or hexadecimal: %11110100 == ~%0001011 == F4 == ~0B\n"));
-  // initialize bit operation
-  initialize_ddr_in(); // set up default ddr (input)
-  initialize_mask(); // set up default mask
-  mask_enabled_for_display(); // enable mask for display
-  input_pullup(); // Enable pull-up for input
-  ledlen = bit_pixel_set(".P", pixled);  // pre-set value for pixel
-  bit_pixel_dump(ledlen, pixled); // display pixel preset values
-  adps_set("7"); // ADC prescaler 1/128
-  aref_set("1"); // VREF=Vcc
-  strcpy(sx, "D");  // initial safe value
-  print_crlf(); // end of initialization
-  // display mcu states
-  display_digital();
-  // main infinite loop
+static void adc_burst(uint8_t j, int16_t *x, uint16_t n) {
+  ADCSRA |= _BV(ADEN);  // ADC Enable (keep ADPS set by AP)
+  adc_mux(j);
+  ADCSRB &= ~0x07;  // ADTS2:0 = 0: free running
+  ADCSRA |= _BV(ADATE) | _BV(ADIF) | _BV(ADSC);
+  // discard the first conversion after the MUX change
+  do {
+  } while (!(ADCSRA & _BV(ADIF)));
+  ADCSRA |= _BV(ADIF);
+  while (n--) {
+    do {
+    } while (!(ADCSRA & _BV(ADIF)));
+    ADCSRA |= _BV(ADIF);
+    *x++ = ADC;
+  }
+  ADCSRA &= ~_BV(ADATE);
+}
+//
+// Fixed-point (Q15) in-place radix-2 FFT
+//
+// 1/4 + 1/2 period of sin(2 pi i / 256) in Q15 (cos = sin shifted by 64)
+#define FFT_LOG2_WAVE 8
+#define FFT_WAVE (1 << FFT_LOG2_WAVE)
+static const int16_t fft_sine[FFT_WAVE * 3 / 4] PROGMEM = {
+       0,    804,   1608,   2410,   3212,   4011,   4808,   5602,
+    6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+   12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,
+   18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+   23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,
+   27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+   30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,
+   32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+   32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,
+   32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+   30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,
+   27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+   23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,
+   18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+   12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,
+    6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+       0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,
+   -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+  -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+  -18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+  -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+  -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+  -30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+  -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+};
+
+static inline int16_t fft_mul(int16_t a, int16_t b) {
+  return (int16_t)(((int32_t)a * b) >> 15);
+}
+//
+// fr[], fi[]: real/imaginary part of 2^m points (m <= 8)
+// Each stage is scaled by 1/2, so the result is scaled by 1/2^m.
+//
+static void fft_q15(int16_t *fr, int16_t *fi, uint8_t m) {
+  uint16_t n = 1 << m;
+  uint16_t i, j, k, l, mr, istep;
+  uint8_t shift;
+  int16_t wr, wi, tr, ti, qr, qi;
+  // bit reversal reordering
+  mr = 0;
+  for (k = 1; k < n; k++) {
+    l = n;
+    do {
+      l >>= 1;
+    } while (mr + l > n - 1);
+    mr = (mr & (l - 1)) + l;
+    if (mr <= k) continue;
+    tr = fr[k];
+    fr[k] = fr[mr];
+    fr[mr] = tr;
+    ti = fi[k];
+    fi[k] = fi[mr];
+    fi[mr] = ti;
+  }
+  // butterflies
+  shift = FFT_LOG2_WAVE - 1;
+  for (l = 1; l < n; l = istep) {
+    istep = l << 1;
+    for (k = 0; k < l; k++) {
+      j = k << shift;
+      wr = (int16_t)pgm_read_word(&fft_sine[j + FFT_WAVE / 4]) >> 1;
+      wi = -((int16_t)pgm_read_word(&fft_sine[j]) >> 1);
+      for (i = k; i < n; i += istep) {
+        j = i + l;
+        tr = fft_mul(wr, fr[j]) - fft_mul(wi, fi[j]);
+        ti = fft_mul(wr, fi[j]) + fft_mul(wi, fr[j]);
+        qr = fr[i] >> 1;
+        qi = fi[i] >> 1;
+        fr[j] = qr - tr;
+        fi[j] = qi - ti;
+        fr[i] = qr + tr;
+        fi[i] = qi + ti;
+      }
+    }
+    shift--;
+  }
+}
+//
+// |z| ~ max + 3/8 min (alpha max plus beta min, error < 7%)
+//
+static uint16_t fft_mag(int16_t re, int16_t im) {
+  uint16_t a, b;
+  a = (re < 0) ? -re : re;
+  b = (im < 0) ? -im : im;
+  if (a < b) {
+    uint16_t t = a;
+    a = b;
+    b = t;
+  }
+  return a + (b >> 2) + (b >> 3);
+}
+//
+// Capture 2^m ADC samples of MUX j into data[], transform in place and
+// print the fft_top strongest bins (DC excluded).
+//
+static void analog_fft(uint8_t j, uint8_t m) {
+  int16_t *fr = (int16_t *)data;
+  int16_t *fi;
+  uint16_t n;
+  uint16_t i, k;
+  int32_t sum;
+  uint16_t cycles;
+  uint32_t fs;
+  uint8_t top[16];
+  uint8_t ntop;
+  uint8_t tccr1b;
+  if (!timer_free(1)) return;
+  if (m < 6) m = 6;
+  if (m > 8) m = 8;
+  n = 1 << m;
+  fi = fr + n;
+  ntop = (fft_top > 16) ? 16 : fft_top;
+  if (ntop > n / 2 - 1) ntop = n / 2 - 1;
+  adc_burst(j, fr, n);
+  // remove DC and scale 10 bit ADC data to Q15
+  sum = 0;
+  for (i = 0; i < n; i++) sum += fr[i];
+  sum >>= m;
+  for (i = 0; i < n; i++) {
+    fr[i] = (fr[i] - (int16_t)sum) << 5;
+    fi[i] = 0;
+  }
+  // count CPU cycles / 64 with Timer1
+  tccr1b = TCCR1B;
+  t1_uses++;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  TCCR1B = _BV(CS11) | _BV(CS10);  // clk/64
+  fft_q15(fr, fi, m);
+  cycles = TCNT1;
+  TCCR1B = tccr1b;
+  // magnitude spectrum of the lower half (in place of fr[])
+  for (i = 0; i < n / 2; i++) {
+    fr[i] = fft_mag(fr[i], fi[i]);
+  }
+  // sampling frequency in Hz
+  k = ADCSRA & 0x07;  // ADPS2:0 (0 and 1 are both 1/2)
+  fs = F_CPU / ((uint32_t)(1 << (k ? k : 1)) * 13);
+  print_sP(PSTR("FFT N="));
+  print_dec(n);
+  print_sP(PSTR(" fs="));
+  print_dec(fs);
+  print_sP(PSTR(" Hz bin="));
+  print_dec(fs >> m);
+  print_sP(PSTR(" Hz DC="));
+  print_hex4((uint16_t)sum);
+  print_sP(PSTR(" cycles="));
+  print_dec((uint32_t)cycles * 64);
+  print_crlf();
+  // pick the strongest bins (selection, DC bin 0 excluded)
+  fr[0] = 0;
+  for (k = 0; k < ntop; k++) {
+    top[k] = 0;
+    for (i = 1; i < n / 2; i++) {
+      if ((uint16_t)fr[i] > (uint16_t)fr[top[k]]) top[k] = i;
+    }
+    print_sP(PSTR("  bin="));
+    print_hex2(top[k]);
+    print_sP(PSTR(" f="));
+    print_dec(((uint32_t)top[k] * fs) >> m);
+    print_sP(PSTR(" Hz mag="));
+    print_hex4(fr[top[k]]);
+    print_crlf();
+    fr[top[k]] = 0;  // exclude from the next search
+  }
+}
+
+//
+// Analog comparator triggered Timer1 input capture
+//
+// AIN0 (or the bandgap if bg) is compared against AIN1 (or the ADC MUX j if
+// mux is given).  Each ACO edge latches Timer1 into ICR1 in hardware, so the
+// recorded intervals are exact to one timer tick regardless of the polling
+// loop.  Intervals between edges are recorded in data[] (0xfffe: overflow).
+//
+static void analog_capture(uint8_t bg, char *mux, char *cs) {
+  uint8_t x;      // comparator output at start
+  uint8_t ovf;    // Timer1 overflows since the last edge
+  uint16_t t;     // captured time
+  uint16_t t0;    // last captured time
+  uint32_t dt;    // interval
+  uint16_t i;     // data[] record index
+  uint8_t c;      // Timer1 clock select
+  data[0] = 0;  // no valid data
+  if (!timer_free(1)) return;
+  c = (cs == NULL) ? 1 : (str2byte(cs) & 0x07);
+  if (c == 0 || c > 5) c = 1;
+  print_sP(PSTR("COMPARATOR CAPTURE START " AIN_PINS "\n"));
+#ifdef NO_AIN1
+  if (mux == NULL) mux = "0";
+#endif
+  if (mux == NULL || *mux == '-') {
+    ADCSRB &= ~_BV(ACME);  // AIN1 as negative input
+  } else {
+    ADCSRA &= ~_BV(ADEN);  // MUX is routed to the comparator only if ADC off
+    ADCSRB |= _BV(ACME);
+    adc_mux(str2byte(mux));
+  }
+  ACSR = (bg ? _BV(ACBG) : 0);  // ACD=0, ACIS=0
+  _delay_ms(1);  // bandgap and comparator settle
+  ACSR |= _BV(ACI) | _BV(ACIC);  // ACO to Timer1 input capture
+  x = (ACSR & _BV(ACO)) ? 1 : 0;
+  data[0] = 0xac00 | (x << 4) | c;
+  t1_uses++;
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  // noise canceler on, wait for the edge opposite to the current level
+  TCCR1B = _BV(ICNC1) | (x ? 0 : _BV(ICES1)) | c;
+  TIFR1 = _BV(ICF1) | _BV(TOV1);
+  i = 1;
+  t0 = 0;
+  ovf = 0;
+  while (i < DATASIZE - 2) {
+    if ((TIFR1 & _BV(TOV1)) && !(TIFR1 & _BV(ICF1))) {
+      TIFR1 = _BV(TOV1);
+      if (ovf < 0xff) ovf++;
+    }
+    if (TIFR1 & _BV(ICF1)) {
+      t = ICR1;
+      TCCR1B ^= _BV(ICES1);  // next edge is the opposite one
+      if ((TIFR1 & _BV(TOV1)) && t < 0x8000) {
+        // overflow happened before this capture
+        TIFR1 = _BV(TOV1);
+        if (ovf < 0xff) ovf++;
+      }
+      TIFR1 = _BV(ICF1);  // clear after the ICES1 change
+      if (i == 1) {
+        dt = 0;  // trigger
+      } else {
+        dt = ((uint32_t)ovf << 16) + t - t0;
+      }
+      data[i++] = (dt > 0xfffe) ? 0xfffe : dt;
+      t0 = t;
+      ovf = 0;
+    }
+    if (check_input()) break;
+  }
+  data[i] = 0xffff; // end of data marker
+  TCCR1B = 0;
+  ACSR &= ~(_BV(ACIC) | _BV(ACBG));
+  ADCSRB &= ~_BV(ACME);
+  print_sP(PSTR("COMPARATOR CAPTURE END\n"));
+}
+
+//
+// Standalone datalogger: the capture armed by LC starts at power-up and
+// logs into EEPROM until a host connects (USB DTR set / a character
+// received) or the log is full.  LS runs it from the command line.
+//
+// The log is a byte stream ended by the erased 0xff (LE): 0xfe 0x00 =
+// 0xfe, 0xfe 0x01 = 0xff, 0xfe 0x02 = session start, then mode and the
+// first value (PIN & mask, or MUX).  Records of a session:
+//   LOG_PINS:  dt, PIN & mask
+//   LOG_EDGES: dt (the BIT pin level toggles)
+//   LOG_ADC:   min, max, average of ADC >> 2 every period ms
+// dt is a LEB128 count of TIMER1 clk/1024 ticks since the last record.
+// data[] stages bytes while an EEPROM write (3.4 ms) is pending.
+//
+#define LOG_OFF 0
+#define LOG_PINS 1
+#define LOG_EDGES 2
+#define LOG_ADC 3
+#define LOG_ESC 0xfe
+#define LOG_MARK 0x100       // log_get(): session start
+#define LOG_RING (2 * DATASIZE)
+
+typedef struct {
+  uint8_t mode;     // LOG_* (erased 0xff: off)
+  uint8_t port;     // port index
+  uint8_t mask;     // PIN bits
+  uint8_t pullup;   // PORT bits of mask (input pull-up)
+  uint8_t mux;      // ADC MUX
+  uint16_t period;  // ADC record period (ms)
+} log_cfg_t;
+
+static log_cfg_t ee_log_cfg EEMEM;
+static uint8_t ee_log[LOG_SIZE] EEMEM;
+static log_cfg_t log_cfg;
+static uint16_t log_end;   // next EEPROM byte
+static uint16_t log_head;  // data[] ring (bytes): next in
+static uint16_t log_tail;  // data[] ring (bytes): next out
+static uint8_t log_ran;    // logged at power-up
+
+static uint16_t log_find_end(void) {
+  uint16_t i;
+  for (i = 0; i < LOG_SIZE; i++) {
+    if (eeprom_read_byte(&ee_log[i]) == 0xff) break;
+  }
+  return i;
+}
+
+// move a byte to EEPROM if it is ready, return 0 if the log is full
+static uint8_t log_flush(void) {
+  if (log_tail != log_head && eeprom_is_ready()) {
+    if (log_end >= LOG_SIZE - 1) return 0;  // keep the 0xff end
+    eeprom_write_byte(&ee_log[log_end++], ((uint8_t *)data)[log_tail]);
+    log_tail = (log_tail + 1) % LOG_RING;
+  }
+  return 1;
+}
+
+static void log_raw(uint8_t b) {
+  uint16_t h = (log_head + 1) % LOG_RING;
+  while (h == log_tail) {
+    if (!log_flush()) return;  // full: drop
+  }
+  ((uint8_t *)data)[log_head] = b;
+  log_head = h;
+}
+
+static void log_put(uint8_t b) {
+  if (b >= LOG_ESC) {
+    log_raw(LOG_ESC);
+    b -= LOG_ESC;
+  }
+  log_raw(b);
+}
+
+static void log_dt(uint32_t dt) {
+  while (dt >= 0x80) {
+    log_put(0x80 | (uint8_t)dt);
+    dt >>= 7;
+  }
+  log_put(dt);
+}
+
+// run the armed capture until stop() is true or the log is full
+static void log_run(uint8_t (*stop)(void)) {
+  volatile uint8_t *pinr = &IOREG(PIN_0, log_cfg.port);
+  uint8_t x, x0, first;
+  uint8_t started = 0;
+  uint8_t v, vmin = 0xff, vmax = 0;
+  uint32_t n = 0;    // ADC conversions in this period (~9.6 k/s)
+  uint32_t sum = 0;
+  uint32_t t, t0;
+  uint32_t period = (uint32_t)(log_cfg.period ? log_cfg.period : 1) *
+                    T1_TPS / 1000;
+  if (!t1_start(T1_CLK1024)) return;
+  log_end = log_find_end();
+  log_head = log_tail = 0;
+  if (log_cfg.mode == LOG_ADC) {
+    ADMUX = _BV(REFS0);  // VREF=Vcc
+    adc_mux(log_cfg.mux);
+    ADCSRA = _BV(ADEN) | _BV(ADSC) | 0x07;  // 1/128
+    first = log_cfg.mux;
+  } else {
+    // pull-ups as armed by LC (all pins are tri-state at power-up)
+    IOREG(PORT_0, log_cfg.port) |= log_cfg.pullup;
+    _delay_us(10);  // settle
+    first = *pinr & log_cfg.mask;
+  }
+  x0 = first;
+  t0 = t1_time();
+  while (!stop()) {
+    if (!log_flush()) break;  // full
+    if (log_cfg.mode == LOG_ADC) {
+      if (ADCSRA & _BV(ADSC)) continue;
+      v = ADC >> 2;
+      ADCSRA |= _BV(ADSC);
+      if (v < vmin) vmin = v;
+      if (v > vmax) vmax = v;
+      sum += v;
+      n++;
+      if (t1_time() - t0 < period) continue;
+      t0 += period;
+    } else {
+      x = *pinr & log_cfg.mask;
+      if (x == x0) continue;
+      x0 = x;
+      t = t1_time();
+    }
+    if (!started) {
+      // session start only when there is a record
+      log_raw(LOG_ESC);
+      log_raw(LOG_MARK - LOG_ESC);
+      log_put(log_cfg.mode);
+      log_put(first);
+      started = 1;
+    }
+    if (log_cfg.mode == LOG_ADC) {
+      log_put(vmin);
+      log_put(vmax);
+      log_put(sum / n);
+      vmin = 0xff;
+      vmax = 0;
+      sum = 0;
+      n = 0;
+    } else {
+      log_dt(t - t0);
+      t0 = t;
+      if (log_cfg.mode == LOG_PINS) log_put(x);
+    }
+  }
+  while (log_tail != log_head && log_flush()) ;  // drain
+  TCCR1B = 0;
+  TIMSK1 &= ~_BV(TOIE1);
+  data[0] = 0xffff;  // data[] holds no record
+}
+
+// power-up: run the armed capture until the host connects
+static void log_autostart(void) {
+  eeprom_read_block(&log_cfg, &ee_log_cfg, sizeof(log_cfg_t));
+  if (log_cfg.mode == LOG_OFF || log_cfg.mode > LOG_ADC) return;
+  log_run(&comm_ready);
+  log_ran = 1;
+}
+
+static void log_report(void) {
+  print_sP(PSTR("LOG mode="));
+  print_hex1(log_cfg.mode);
+  print_sP(PSTR(" pins="));
+  print_c(PORT_BGN_CH + log_cfg.port);
+  print_c(':');
+  print_hex2(log_cfg.mask);
+  print_sP(PSTR(" pull-up="));
+  print_hex2(log_cfg.pullup);
+  print_sP(PSTR(" mux="));
+  print_hex2(log_cfg.mux);
+  print_sP(PSTR(" period="));
+  print_hex4(log_cfg.period);
+  print_sP(PSTR(" ms used="));
+  print_hex4(log_find_end());
+  print_c('/');
+  print_hex4(LOG_SIZE - 1);
+  print_sP(PSTR(" bytes\n"));
+}
+
+// next unescaped byte, LOG_MARK, or -1 at the end
+static int16_t log_get(uint16_t *i) {
+  uint8_t b;
+  if (*i >= LOG_SIZE) return -1;
+  b = eeprom_read_byte(&ee_log[(*i)++]);
+  if (b == 0xff) return -1;
+  if (b != LOG_ESC) return b;
+  if (*i >= LOG_SIZE) return -1;
+  b = eeprom_read_byte(&ee_log[(*i)++]);
+  if (b == 0xff) return -1;
+  return LOG_ESC + b;
+}
+
+// print TIMER1 clk/1024 ticks as ms
+static void log_time(uint32_t t) {
+  print_dec((t / T1_TPS) * 1000 + (t % T1_TPS) * 1000 / T1_TPS);
+  print_sP(PSTR(" ms "));
+}
+
+static void log_dump(void) {
+  uint16_t i = 0, k = 0;
+  int16_t c;
+  uint8_t mode = LOG_OFF, x = 0, sh;
+  uint32_t t = 0, dt;
+  print_sP(PSTR("LOG DUMP\n"));
+  while ((c = log_get(&i)) >= 0) {
+    if (c == LOG_MARK) {
+      mode = log_get(&i);
+      x = log_get(&i);
+      t = 0;
+      k = 0;
+      print_sP(PSTR("SESSION mode="));
+      print_hex1(mode);
+      print_sP(PSTR(" first="));
+      print_hex2(x);
+      print_crlf();
+      continue;
+    }
+    print_hex4(k++);
+    print_c(' ');
+    if (mode == LOG_ADC) {
+      print_sP(PSTR("MIN="));
+      print_hex2(c);
+      print_sP(PSTR(" MAX="));
+      print_hex2(log_get(&i));
+      print_sP(PSTR(" AVG="));
+      print_hex2(log_get(&i));
+    } else {
+      dt = 0;
+      sh = 0;
+      while (c & 0x80) {
+        dt |= (uint32_t)(c & 0x7f) << sh;
+        sh += 7;
+        if ((c = log_get(&i)) < 0) break;
+      }
+      if (c < 0) break;
+      t += dt | ((uint32_t)c << sh);
+      log_time(t);
+      if (mode == LOG_PINS) {
+        print_bin8(log_get(&i), 0xff);
+      } else {
+        x = !x;
+        print_sP(x ? PSTR("L->H") : PSTR("H->L"));
+      }
+    }
+    print_crlf();
+  }
+  print_sP(PSTR("LOG DUMP END\n"));
+}
+
+//
+// Persisted configuration: CS saves one versioned record in EEPROM which
+// is applied at reset, so scripts need not re-send SM, B, BTS, BTU ...
+// The record keeps DDR and PORT of all ports (the BIT pin mode), mask[],
+// the BIT pin, tspan, unit, tcount, PWM, ADC prescaler and reference, and
+// up to CFG_LED bytes of LED data.  CFG_QUIET skips the banner and the
+// initial displays at reset.  CE erases the version byte.
+//
+#define CFG_VER 0x01
+#define CFG_QUIET 0x01
+
+typedef struct {
+  uint8_t ver;             // CFG_VER (erased 0xff: none)
+  uint8_t size;            // sizeof(cfg_t)
+  uint8_t flags;           // CFG_*
+  uint8_t ddr[N_PORTS];
+  uint8_t port[N_PORTS];
+  uint8_t mask[N_PORTS];
+  uint8_t mask_override;
+  uint8_t bit_port;        // BIT pin port index
+  uint8_t bit;             // BIT pin bit
+  uint16_t tspan;
+  uint16_t unit;
+  uint8_t tcount;
+  uint8_t t_pwm;
+  uint8_t adps;            // ADCSRA ADPS2:0
+  uint8_t aref;            // ADMUX REFS1:0
+  uint16_t ledlen;         // LED bytes in ee_cfg_led[]
+} cfg_t;
+
+static cfg_t ee_cfg EEMEM;
+static uint8_t ee_cfg_led[CFG_LED] EEMEM;
+
+static void cfg_save(uint8_t flags) {
+  cfg_t c;
+  uint8_t i;
+  c.ver = CFG_VER;
+  c.size = sizeof(cfg_t);
+  c.flags = flags;
+  for (i = 0; i < N_PORTS; i++) {
+    c.ddr[i] = IOREG(DDR_0, i);
+    c.port[i] = IOREG(PORT_0, i);
+    c.mask[i] = mask[i];
+  }
+  c.mask_override = mask_override;
+  c.bit_port = (addr_pin - _SFR_ADDR(PIN_0)) / 3;
+  c.bit = addr_bit;
+  c.tspan = tspan;
+  c.unit = unit;
+  c.tcount = tcount;
+  c.t_pwm = t_pwm;
+  c.adps = ADCSRA & 0x07;
+  c.aref = ADMUX >> 6;
+  c.ledlen = (ledlen < CFG_LED) ? ledlen : CFG_LED - CFG_LED % 3;
+  eeprom_update_block(pixled, ee_cfg_led, c.ledlen);
+  eeprom_update_block(&c, &ee_cfg, sizeof(cfg_t));  // header last
+}
+
+// return 0 if there is no valid record
+static uint8_t cfg_read(cfg_t *c) {
+  eeprom_read_block(c, &ee_cfg, sizeof(cfg_t));
+  return c->ver == CFG_VER && c->size == sizeof(cfg_t);
+}
+
+// apply a valid record without any message (led_init() done)
+static void cfg_apply(cfg_t *c) {
+  uint8_t i;
+  for (i = 0; i < N_PORTS; i++) {
+    IOREG(PORT_0, i) = c->port[i];  // pull-up before output high
+    IOREG(DDR_0, i) = c->ddr[i];
+    mask[i] = c->mask[i];
+  }
+  mask_override = c->mask_override;
+  if (c->bit_port < N_PORTS) bit_pin_at(c->bit_port, c->bit);
+  tspan = c->tspan;
+  unit = c->unit;
+  tcount = c->tcount;
+  t_pwm = c->t_pwm;
+  ADCSRA = (ADCSRA & ~0x07) | (c->adps & 0x07);
+  ADMUX = (ADMUX & 0x3f) | (c->aref << 6);
+  ledlen = c->ledlen;
+  if (ledlen > CFG_LED) ledlen = 0;
+  if (ledlen > ledmax) ledlen = ledmax - ledmax % 3;
+  eeprom_read_block(pixled, ee_cfg_led, ledlen);
+}
+
+static void cfg_report(cfg_t *c) {
+  print_sP(PSTR(" quiet="));
+  print_hex1(c->flags & CFG_QUIET);
+  print_sP(PSTR(" LEDs="));
+  print_hex4(c->ledlen / 3);
+  print_sP(PSTR(" (max "));
+  print_hex4(CFG_LED / 3);
+  print_sP(PSTR(")\n"));
+}
+
+//
+// Background tasks: a cooperative scheduler run by input_char() while it
+// waits for a key, so the command line stays usable.  A 1 ms tick on
+// TIMER SCHED_TIMER (CTC, clk/64) times the tasks; OCnx waves of that
+// timer fall back to the soft output while tasks run.  A task runs to
+// completion each time it is due and returns the ms to its next run
+// (0: every pass).  Tasks pause while a command runs.
+//
+// CPU share is the tick counts (4 us) spent in each task since the last
+// TL, out of the elapsed counts.
+//
+#if SCHED_TIMER == 2
+#define SCHED_vect TIMER2_COMPA_vect
+#define SCHED_TCCRA TCCR2A
+#define SCHED_TCCRB TCCR2B
+#define SCHED_TCNT TCNT2
+#define SCHED_OCRA OCR2A
+#define SCHED_TIMSK TIMSK2
+#define SCHED_TIFR TIFR2
+#define SCHED_OCF _BV(OCF2A)
+#define SCHED_OCIE _BV(OCIE2A)
+#define SCHED_CTCA _BV(WGM21)  // mode 2 (CTC)
+#define SCHED_CTCB 0
+#define SCHED_CS _BV(CS22)     // clk/64
+#else
+#define SCHED_vect TIMER3_COMPA_vect
+#define SCHED_TCCRA TCCR3A
+#define SCHED_TCCRB TCCR3B
+#define SCHED_TCNT TCNT3
+#define SCHED_OCRA OCR3A
+#define SCHED_TIMSK TIMSK3
+#define SCHED_TIFR TIFR3
+#define SCHED_OCF _BV(OCF3A)
+#define SCHED_OCIE _BV(OCIE3A)
+#define SCHED_CTCA 0
+#define SCHED_CTCB _BV(WGM32)  // mode 4 (CTC)
+#define SCHED_CS (_BV(CS31) | _BV(CS30))  // clk/64
+#endif
+#define SCHED_TOP (F_CPU / 64 / 1000 - 1)  // 1 ms
+
+#define TASK_N 4
+#define TASK_FREE 0
+#define TASK_BLINK 1  // toggle a pin
+#define TASK_PWM 2    // slow software PWM of a pin
+#define TASK_MON 3    // print changes of the active input pins
+#define TASK_ADC 4    // print an ADC reading
+
+typedef struct {
+  uint8_t kind;               // TASK_*
+  uint8_t arg;                // PWM duty (x/0x100), ADC MUX
+  uint8_t mask;               // pin bit (BLINK, PWM)
+  uint8_t x;                  // PWM: high phase, MON: printed once
+  volatile uint8_t *pinr;     // PIN register (BLINK, PWM)
+  uint16_t period;            // ms (PWM: cycle)
+  uint32_t next;              // sched_ms of the next run
+  uint32_t busy;              // tick counts spent in the task
+  uint8_t last[N_PORTS];      // MON: masked PIN
+} task_t;
+
+static task_t task[TASK_N];
+static volatile uint32_t sched_ms;  // ms since the first task started
+static uint32_t sched_t0;           // tick counts at the last TL
+static uint8_t sched_on;
+
+ISR(SCHED_vect) { sched_ms++; }
+
+// tick counts (4 us) since the scheduler started
+static uint32_t sched_counts(void) {
+  uint32_t ms;
+  uint16_t c;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ms = sched_ms;
+    c = SCHED_TCNT;
+    if ((SCHED_TIFR & SCHED_OCF) && c < SCHED_TOP / 2) ms++;  // pending
+  }
+  return ms * (SCHED_TOP + 1) + c;
+}
+
+static void task_time(void) {
+  uint32_t ms;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { ms = sched_ms; }
+  print_hex4(ms >> 16);
+  print_hex4(ms);
+}
+
+static void task_level(task_t *t, uint8_t high) {
+  volatile uint8_t *portr = t->pinr + 2;  // PINx, DDRx, PORTx
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (high) {
+      *portr |= t->mask;
+    } else {
+      *portr &= ~t->mask;
+    }
+  }
+}
+
+// run task i once, return ms to its next run
+static uint16_t task_run(uint8_t i) {
+  task_t *t = &task[i];
+  uint8_t k, v, changed;
+  uint16_t hi;
+  switch (t->kind) {
+  case TASK_BLINK:
+    *t->pinr = t->mask;  // toggle
+    return t->period;
+  case TASK_PWM:
+    hi = (uint32_t)t->period * t->arg / 0x100;
+    t->x ^= 1;
+    if (t->x && hi == 0) t->x = 0;
+    if (!t->x && hi == t->period) t->x = 1;
+    task_level(t, t->x);
+    return t->x ? hi : t->period - hi;
+  case TASK_MON:
+    changed = !t->x;
+    for (k = 0; k < N_PORTS; k++) {
+      v = IOREG(PIN_0, k) & ~IOREG(DDR_0, k) & mask[k];
+      if (v != t->last[k]) changed = 1;
+      t->last[k] = v;
+    }
+    if (changed) {
+      t->x = 1;
+      print_c('T');
+      print_hex1(i);
+      print_c(' ');
+      task_time();
+      print_sP(PSTR(": "));
+      for (k = 0; k < N_PORTS; k++) {
+        print_c(PORT_BGN_CH + k);
+        print_c(':');
+        print_byte(t->last[k], (~IOREG(DDR_0, k) & mask[k]) | mask_override);
+        print_c(' ');
+      }
+      print_crlf();
+    }
+    return t->period;
+  case TASK_ADC:
+    adc_mux(t->arg);
+    ADCSRA |= _BV(ADEN) | _BV(ADSC);
+    while (ADCSRA & _BV(ADSC)) ;
+    print_c('T');
+    print_hex1(i);
+    print_c(' ');
+    task_time();
+    print_sP(PSTR(": ADC="));
+    print_hex4(ADC);
+    print_crlf();
+    return t->period;
+  }
+  return 0;
+}
+
+// input_char() idle hook: run the due tasks
+static void sched_run(void) {
+  uint8_t i;
+  uint16_t step;
+  uint32_t now, c0;
+  for (i = 0; i < TASK_N; i++) {
+    if (task[i].kind == TASK_FREE) continue;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { now = sched_ms; }
+    if ((int32_t)(now - task[i].next) < 0) continue;
+    c0 = sched_counts();
+    step = task_run(i);
+    task[i].busy += sched_counts() - c0;
+    task[i].next += step;  // keep the cadence unless late
+    if ((int32_t)(now - task[i].next) >= 0) task[i].next = now + step;
+  }
+}
+
+// free slot with the scheduler running (NULL if none)
+static task_t *task_new(uint8_t kind, uint16_t period) {
+  uint8_t i;
+  task_t *t;
+  for (i = 0; i < TASK_N && task[i].kind != TASK_FREE; i++) ;
+  if (i == TASK_N) {
+    print_sP(PSTR("E: no free task (TX to stop)\n"));
+    return NULL;
+  }
+  if (!sched_on) {
+    if (!timer_free(SCHED_TIMER)) return NULL;
+    timer_take(SCHED_TIMER);
+    SCHED_TCCRB = 0;
+    SCHED_TCCRA = SCHED_CTCA;
+    SCHED_TCNT = 0;
+    SCHED_OCRA = SCHED_TOP;
+    SCHED_TIFR = SCHED_OCF;
+    SCHED_TIMSK |= SCHED_OCIE;
+    sched_ms = 0;
+    sched_t0 = 0;
+    SCHED_TCCRB = SCHED_CTCB | SCHED_CS;
+    input_idle = sched_run;
+    sched_on = 1;
+  }
+  t = &task[i];
+  memset(t, 0, sizeof(task_t));
+  t->kind = kind;
+  t->period = period;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { t->next = sched_ms; }
+  print_sP(PSTR("TASK "));
+  print_hex1(i);
+  print_sP(PSTR(" START (TX to stop)\n"));
+  return t;
+}
+
+// BIT pin as output low for BLINK, PWM
+static void task_pin(task_t *t) {
+  t->pinr = &_SFR_MEM8(addr_pin);
+  t->mask = _BV(addr_bit);
+  gpio_clr();
+  _SFR_MEM8(addr_ddr) |= t->mask;  // output
+}
+
+static void task_stop(uint8_t i) {
+  uint8_t k;
+  if (task[i].kind == TASK_FREE) return;
+  if (task[i].kind == TASK_PWM) task_level(&task[i], 0);
+  task[i].kind = TASK_FREE;
+  print_sP(PSTR("TASK "));
+  print_hex1(i);
+  print_sP(PSTR(" STOP\n"));
+  for (k = 0; k < TASK_N; k++) {
+    if (task[k].kind != TASK_FREE) return;
+  }
+  // last task: stop the tick
+  input_idle = NULL;
+  SCHED_TIMSK &= ~SCHED_OCIE;
+  SCHED_TCCRB = 0;
+  SCHED_TCCRA = 0;
+  timer_release(SCHED_TIMER);
+  sched_on = 0;
+}
+
+static void task_list(void) {
+  static const char task_name[][6] PROGMEM = {
+      "", "BLINK", "PWM", "MON", "ADC"};
+  uint8_t i, b;
+  uint32_t now = sched_counts();
+  uint32_t total = (now - sched_t0) / 1000 + 1;  // counts per 0.1%
+  uint32_t used = 0, s;
+  for (i = 0; i < TASK_N; i++) {
+    if (task[i].kind == TASK_FREE) continue;
+    print_c('T');
+    print_hex1(i);
+    print_c(' ');
+    print_sP(task_name[task[i].kind]);
+    if (task[i].pinr != NULL) {
+      print_c(' ');
+      for (b = 0; !(task[i].mask & _BV(b)); b++) ;
+      print_c(((uint16_t)task[i].pinr - _SFR_ADDR(PIN_0)) / 3 + PORT_BGN_CH);
+      print_c('0' + b);
+    }
+    print_sP(PSTR(" period="));
+    print_hex4(task[i].period);
+    print_sP(PSTR(" ms arg="));
+    print_hex2(task[i].arg);
+    print_sP(PSTR(" CPU="));
+    s = task[i].busy / total;
+    used += s;
+    print_dec(s / 10);
+    print_c('.');
+    print_dec(s % 10);
+    print_sP(PSTR(" %\n"));
+    task[i].busy = 0;
+  }
+  if (!sched_on) {
+    print_sP(PSTR("NO TASK\n"));
+    return;
+  }
+  print_sP(PSTR("OTHER (command line, commands) CPU="));
+  s = (used < 1000) ? 1000 - used : 0;
+  print_dec(s / 10);
+  print_c('.');
+  print_dec(s % 10);
+  print_sP(PSTR(" %\n"));
+  sched_t0 = now;
+}
+
+//
+// Command handlers: argv[0] is the command, argv[1], ... the arguments
+// (argv[] is NULL padded, so argv[1] and argv[2] are always valid)
+//
+static uint16_t addr_sram_end = 0x00;    // same as start
+static uint16_t addr_sram_range = 0xff;  // range 256 bytes from 0
+static uint16_t addr_flash_end = 0xff;   // end
+static uint16_t addr_flash_range = 0xff; // range from 0
+static uint8_t wval = 0;                 // byte value to write
+
+// read from SRAM (hexdump or alldump) progressive location
+static void cmd_read_sram(char **argv, uint8_t all) {
+  uint16_t addr_sram_tmp;
+  if (argv[1] != NULL) {
+    addr_sram_tmp = addr_sram;
+    addr_sram = str2word(argv[1]);
+    addr_sram_last = addr_sram_tmp;
+  }
+  if (addr_sram > MAX_SRAM) addr_sram = MAX_SRAM;
+  if (argv[2] != NULL) {
+    addr_sram_end = str2word(argv[2]);
+  } else {
+    addr_sram_end = addr_sram + addr_sram_range;
+  }
+  if (addr_sram_end > MAX_SRAM) addr_sram_end = MAX_SRAM;
+  if (addr_sram_end < addr_sram) addr_sram_end = addr_sram;
+  //
+  if (all) {
+    print_alldump(addr_sram, addr_sram_end, &read_sram);
+  } else {
+    print_hexdump(addr_sram, addr_sram_end, &read_sram);
+  }
+  //
+  addr_sram_range = addr_sram_end - addr_sram;
+  addr_sram = addr_sram_end + 1;
+  if (addr_sram > MAX_SRAM) addr_sram = 0;
+  addr_sram_end = addr_sram + addr_sram_range;
+  if (addr_sram_end > MAX_SRAM) addr_sram_end = MAX_SRAM;
+}
+
+static void cmd_r(uint8_t argc, char **argv) { cmd_read_sram(argv, 0); }
+static void cmd_ra(uint8_t argc, char **argv) { cmd_read_sram(argv, 1); }
+
+// read from program memory (hexdump) progressive location
+static void cmd_rp(uint8_t argc, char **argv) {
+  uint16_t addr_flash_tmp;
+  if (argv[1] != NULL) {
+    addr_flash_tmp = addr_flash;
+    addr_flash = str2word(argv[1]);
+    addr_flash_last = addr_flash_tmp;
+  }
+  if (addr_flash > MAX_FLASH) addr_flash = MAX_FLASH;
+  if (argv[2] != NULL) {
+    addr_flash_end = str2word(argv[2]);
+  } else {
+    addr_flash_end = addr_flash + addr_flash_range;
+  }
+  if (addr_flash_end > MAX_FLASH) addr_flash_end = MAX_FLASH;
+  if (addr_flash_end < addr_flash) addr_flash_end = addr_flash;
+  //
+  print_hexdump(addr_flash, addr_flash_end, &read_flash);
+  //
+  addr_flash_range = addr_flash_end - addr_flash;
+  addr_flash = addr_flash_end + 1;
+  if (addr_flash > MAX_FLASH) addr_flash = 0;
+  addr_flash_end = addr_flash + addr_flash_range;
+  if (addr_flash_end > MAX_FLASH) addr_flash_end = MAX_FLASH;
+}
+
+// write to SRAM (alldump) progressive location, one byte per val
+static void cmd_write_sram(uint8_t argc, char **argv,
+                           void (*write)(uint16_t, uint8_t)) {
+  uint16_t addr_sram_tmp;
+  uint8_t i = 2;
+  if (argv[1] != NULL) {
+    addr_sram_tmp = addr_sram;
+    addr_sram = str2word(argv[1]);
+    addr_sram_last = addr_sram_tmp;
+  }
+  do {
+    if (argv[i] != NULL) wval = str2byte(argv[i]);
+    if (addr_sram < MIN_SRAM) return;  // ignore
+    if (addr_sram > MAX_SRAM) return;  // ignore
+    write(addr_sram, wval);
+    print_alldump(addr_sram, addr_sram, &read_sram);
+    addr_sram++;
+    if (addr_sram > MAX_SRAM) addr_sram = MIN_SRAM;
+  } while (++i < argc);
+  print_alldump(addr_sram, addr_sram, &read_sram);
+}
+
+static void cmd_w(uint8_t argc, char **argv) {
+  cmd_write_sram(argc, argv, &write_sram);
+}
+static void cmd_wa(uint8_t argc, char **argv) {
+  cmd_write_sram(argc, argv, &write_and_sram);
+}
+static void cmd_wo(uint8_t argc, char **argv) {
+  cmd_write_sram(argc, argv, &write_or_sram);
+}
+// XXX FIXME XXX (RE, WP, WE)
+static void cmd_nop(uint8_t argc, char **argv) { }
+
+static void cmd_d(uint8_t argc, char **argv) { display_digital(); }
+static void cmd_dc(uint8_t argc, char **argv) { monitor_digital(); }
+//
+// For switching between:
+// * Tri-state ({DDxn, PORTxn} = 0b00)
+// * Output high ({DDxn, PORTxn} = 0b11)
+// We must step through:
+// * Pull-up enabled {DDxn, PORTxn} = 0b01)
+// * Output low ({DDxn, PORTxn} = 0b10)
+//
+// For switching between:
+// * Pull-up enabled {DDxn, PORTxn} = 0b01)
+// * Output low ({DDxn, PORTxn} = 0b10)
+// We must step through:
+// * Tri-state ({DDxn, PORTxn} = 0b00)
+// * Output high ({DDxn, PORTxn} = 0b11)
+//
+// Set PUD bit in MCUCR to disable pull-up
+//
+static void cmd_s(uint8_t argc, char **argv) {
+  output_low();
+  input_tristate();
+  initialize_ddr_in();
+  initialize_mask();
+  display_digital();
+}
+static void cmd_sk(uint8_t argc, char **argv) {
+  output_low();
+  input_tristate();
+  initialize_ddr_inout();
+  initialize_mask();
+  display_digital();
+}
+static void cmd_sc(uint8_t argc, char **argv) { scan_continuity(str2word(argv[1])); }
+static void cmd_skb(uint8_t argc, char **argv) { scan_matrix(str2byte(argv[1])); }
+static void cmd_sm(uint8_t argc, char **argv) {
+  mask_set();
+  display_digital();
+}
+static void cmd_smd(uint8_t argc, char **argv) { mask_disabled_for_display(); }
+static void cmd_sme(uint8_t argc, char **argv) { mask_enabled_for_display(); }
+static void cmd_soh(uint8_t argc, char **argv) { output_high(); }
+static void cmd_sol(uint8_t argc, char **argv) { output_low(); }
+static void cmd_sip(uint8_t argc, char **argv) { input_pullup(); }
+static void cmd_sit(uint8_t argc, char **argv) { input_tristate(); }
+static void cmd_spd(uint8_t argc, char **argv) { set_pud(); }
+static void cmd_spe(uint8_t argc, char **argv) { reset_pud(); }
+
+static void cmd_b(uint8_t argc, char **argv) {
+  if (argv[1] == NULL) {
+    if (_SFR_MEM8(addr_ddr) & _BV(addr_bit)) {
+      bit_toggle(); // output
+      display_digital();
+    } else {
+      bit_record(); // input
+      data_dump(); // input
+    }
+  } else {
+    bit_pin(argv[1], argv[2]);
+  }
+}
+static void cmd_bl(uint8_t argc, char **argv) {
+  bit_off();
+  display_digital();
+}
+static void cmd_bh(uint8_t argc, char **argv) {
+  bit_on();
+  display_digital();
+}
+static void cmd_bd(uint8_t argc, char **argv) { data_dump(); }
+static void cmd_btu(uint8_t argc, char **argv) {
+  if (argv[1] == NULL) {
+    unit = 1; // 1 ms is minimum on normal AVR coding
+  } else {
+    unit = str2word(argv[1]);
+  }
+}
+static void cmd_bts(uint8_t argc, char **argv) {
+  if (argv[1] == NULL) {
+    tspan = 0x8000;
+    tcount = 5; // 5ms is typical switch delay
+  } else {
+    tspan = str2word(argv[1]);
+    if (argv[2] == NULL) {
+      tcount = 5; // 5ms is typical switch delay
+    } else {
+      tcount = str2byte(argv[2]);
+    }
+  }
+}
+static void cmd_bp(uint8_t argc, char **argv) {
+  if (argv[1] == NULL || argv[1][0] != 'P') {
+    bit_record_pins();
+  }
+  data_dump();
+}
+static void cmd_bpg(uint8_t argc, char **argv) { pattern_play(str2word(argv[1]), argv[2]); }
+static void cmd_bpu(uint8_t argc, char **argv) { pattern_upload(str2word(argv[1])); }
+static void cmd_bpx(uint8_t argc, char **argv) { pattern_stop(); }
+static void cmd_ba(uint8_t argc, char **argv) {
+  bit_bounce(str2word(argv[1]), str2byte(argv[2]));
+}
+static void cmd_bb(uint8_t argc, char **argv) {
+  bit_blink(str2word(argv[1]));
+  display_digital();
+}
+static void cmd_bw(uint8_t argc, char **argv) { bit_wave(argv[1], argv[2]); }
+static void cmd_bwx(uint8_t argc, char **argv) { wave_stop(); }
+static void cmd_bg(uint8_t argc, char **argv) { bit_generate(str2word(argv[1])); }
+static void cmd_bgk(uint8_t argc, char **argv) {
+  bit_generate((uint32_t)str2word(argv[1]) * 1000);
+}
+static void cmd_bx(uint8_t argc, char **argv) {
+  if (argv[1] == NULL || *argv[1] == '\0') {
+    bit_pixel(ledlen, pixled);
+  } else if (argv[1][0] == '?' || argv[1][0] == '/') {
+    // NOP
+  } else {
+    ledlen = bit_pixel_set(argv[1], pixled);
+  }
+  bit_pixel_dump(ledlen, pixled);
+}
+static void cmd_bxn(uint8_t argc, char **argv) {
+  bit_pixel_fill(str2word(argv[1]));
+  bit_pixel_dump(ledlen, pixled);
+}
+static void cmd_bxh(uint8_t argc, char **argv) { bit_pixel_hw(argv[1]); }
+static void cmd_bxa(uint8_t argc, char **argv) { led_play(str2byte(argv[1])); }
+static void cmd_bxs(uint8_t argc, char **argv) {
+  led_stream(str2word(argv[1]), str2byte(argv[2]));
+}
+
+static void cmd_ic(uint8_t argc, char **argv) { twi_clock(str2word(argv[1])); }
+static void cmd_is(uint8_t argc, char **argv) { twi_scan(); }
+static void cmd_ia(uint8_t argc, char **argv) { twi_address(argv[1]); }
+static void cmd_ir(uint8_t argc, char **argv) { twi_read_block(argv[1], str2word(argv[2])); }
+static void cmd_iw(uint8_t argc, char **argv) { twi_write_block(argv[1], argv[2]); }
+static void cmd_pm(uint8_t argc, char **argv) { spi_set_mode(argv[1]); }
+static void cmd_pd(uint8_t argc, char **argv) { spi_set_div(argv[1]); }
+static void cmd_pc(uint8_t argc, char **argv) { spi_set_cs(argv[1]); }
+static void cmd_px(uint8_t argc, char **argv) { spi_xfer(argv[1], str2word(argv[2])); }
+static void cmd_ps(uint8_t argc, char **argv) {
+  spi_sample(str2word(argv[1]), str2byte(argv[2]));
+}
+static void cmd_ni(uint8_t argc, char **argv) { sniff_i2c(); }
+static void cmd_ns(uint8_t argc, char **argv) { sniff_spi(str2byte(argv[1])); }
+static void cmd_nu(uint8_t argc, char **argv) { sniff_uart(str2word(argv[1])); }
+static void cmd_fm(uint8_t argc, char **argv) { freq_meter(); }
+static void cmd_gc(uint8_t argc, char **argv) { glitch_start(str2byte(argv[1])); }
+static void cmd_gs(uint8_t argc, char **argv) { glitch_status(); }
+static void cmd_gx(uint8_t argc, char **argv) { glitch_stop(); }
+
+// TB word: blink the BIT pin every word ms (1F4)
+static void cmd_tb(uint8_t argc, char **argv) {
+  task_t *t = task_new(TASK_BLINK, argv[1] ? str2word(argv[1]) : 0x1f4);
+  if (t != NULL) task_pin(t);
+}
+// TP val word: PWM the BIT pin val/0x100 (80) with a word ms cycle (14)
+static void cmd_tp(uint8_t argc, char **argv) {
+  uint16_t cycle = argv[2] ? str2word(argv[2]) : 0x14;
+  task_t *t = task_new(TASK_PWM, (cycle < 2) ? 2 : cycle);
+  if (t == NULL) return;
+  task_pin(t);
+  t->arg = argv[1] ? str2byte(argv[1]) : 0x80;
+}
+// TM word: print changes of the active INPUT pins, polled every word ms (0A)
+static void cmd_tm(uint8_t argc, char **argv) {
+  task_new(TASK_MON, argv[1] ? str2word(argv[1]) : 0x0a);
+}
+// TA val word: print ADC MUX val every word ms (3E8)
+static void cmd_ta(uint8_t argc, char **argv) {
+  task_t *t = task_new(TASK_ADC, argv[2] ? str2word(argv[2]) : 0x3e8);
+  if (t != NULL) t->arg = str2byte(argv[1]);
+}
+static void cmd_tl(uint8_t argc, char **argv) { task_list(); }
+// TX val: stop task val (all)
+static void cmd_tx(uint8_t argc, char **argv) {
+  uint8_t i;
+  if (argv[1] != NULL) {
+    i = str2byte(argv[1]);
+    if (i < TASK_N) task_stop(i);
+  } else {
+    for (i = 0; i < TASK_N; i++) task_stop(i);
+  }
+}
+
+// CS val: save the configuration, val=1: quiet reset (0)
+static void cmd_cs(uint8_t argc, char **argv) {
+  cfg_t c;
+  cfg_save(str2byte(argv[1]) ? CFG_QUIET : 0);
+  cfg_read(&c);
+  print_sP(PSTR("CONFIG SAVED"));
+  cfg_report(&c);
+}
+static void cmd_cl(uint8_t argc, char **argv) {
+  cfg_t c;
+  if (!cfg_read(&c)) {
+    print_sP(PSTR("E: no saved config (CS)\n"));
+    return;
+  }
+  cfg_apply(&c);
+  print_sP(PSTR("CONFIG LOADED"));
+  cfg_report(&c);
+  display_digital();
+}
+static void cmd_ce(uint8_t argc, char **argv) {
+  eeprom_update_byte(&ee_cfg.ver, 0xff);
+  print_sP(PSTR("CONFIG ERASED (defaults at reset)\n"));
+}
+
+// LC mode val word: 0: off, 1: changes of the active INPUT pins of the
+// BIT port, 2: BIT pin edges, 3: ADC MUX val every word ms (3E8)
+static void cmd_lc(uint8_t argc, char **argv) {
+  uint8_t port = (addr_pin - _SFR_ADDR(PIN_0)) / 3;
+  if (argv[1] != NULL) {
+    log_cfg.mode = str2byte(argv[1]);
+    if (log_cfg.mode > LOG_ADC) log_cfg.mode = LOG_OFF;
+    log_cfg.port = port;
+    log_cfg.mask = (log_cfg.mode == LOG_EDGES)
+                       ? _BV(addr_bit)
+                       : mask[port] & ~_SFR_MEM8(addr_ddr);
+    log_cfg.pullup = _SFR_MEM8(addr_port) & log_cfg.mask;
+    log_cfg.mux = str2byte(argv[2]);
+    log_cfg.period = (argv[3] != NULL) ? str2word(argv[3]) : 0x3e8;
+    eeprom_update_block(&log_cfg, &ee_log_cfg, sizeof(log_cfg_t));
+  } else {
+    eeprom_read_block(&log_cfg, &ee_log_cfg, sizeof(log_cfg_t));
+  }
+  log_report();
+}
+static void cmd_ld(uint8_t argc, char **argv) { log_dump(); }
+static void cmd_le(uint8_t argc, char **argv) {
+  uint16_t i;
+  for (i = 0; i < LOG_SIZE; i++) eeprom_update_byte(&ee_log[i], 0xff);
+  print_sP(PSTR("LOG ERASED\n"));
+}
+static void cmd_ls(uint8_t argc, char **argv) {
+  eeprom_read_block(&log_cfg, &ee_log_cfg, sizeof(log_cfg_t));
+  if (log_cfg.mode == LOG_OFF || log_cfg.mode > LOG_ADC) {
+    print_sP(PSTR("E: no capture armed (LC)\n"));
+    return;
+  }
+  print_sP(PSTR("LOG START (any key to stop)\n"));
+  log_run(&check_input);
+  log_report();
+}
+
+static void cmd_ar(uint8_t argc, char **argv) { aref_set(argv[1]); }
+static void cmd_ap(uint8_t argc, char **argv) { adps_set(argv[1]); }
+static void cmd_a(uint8_t argc, char **argv) { monitor_analog(); }
+static void cmd_ax(uint8_t argc, char **argv) { analog_off(); }
+static void cmd_af(uint8_t argc, char **argv) {
+  analog_fft((argv[1] == NULL) ? 0 : str2byte(argv[1]),
+             (argv[2] == NULL) ? 8 : str2byte(argv[2]));
+}
+static void cmd_ac(uint8_t argc, char **argv) {
+  analog_capture(0, argv[1], argv[2]);
+  data_dump();
+}
+static void cmd_acb(uint8_t argc, char **argv) {
+  analog_capture(1, argv[1], argv[2]);
+  data_dump();
+}
+static void cmd_afn(uint8_t argc, char **argv) {
+  if (argv[1] == NULL) {
+    fft_top = 5;
+  } else {
+    fft_top = str2byte(argv[1]);
+  }
+}
+
+static void cmd_qm(uint8_t argc, char **argv) {
+  print_sP(PSTR("byte -> bin / hex / ~hex / ascii >> "));
+  print_byte(str2byte(argv[1]), 0xff);
+  print_ascii(str2byte(argv[1]));
+  print_crlf();
+}
+static void cmd_qq(uint8_t argc, char **argv) {
+  print_sP(PSTR("word -> hex / ~hex >> "));
+  print_hex4(str2word(argv[1]));
+  print_sP(PSTR(" = ~"));
+  print_hex4(~str2word(argv[1]));
+  print_crlf();
+}
+static void cmd_h(uint8_t argc, char **argv);
+static void cmd_md(uint8_t argc, char **argv);
+static void cmd_ml(uint8_t argc, char **argv);
+static void cmd_mr(uint8_t argc, char **argv);
+
+//
+// Command table (PROGMEM), sorted by name for the binary search
+//
+// CMD(id, name, handler, "args\thelp"): an empty help string hides an
+// alias or a placeholder from H.  Keep the list sorted by name (strcmp
+// order: '/' < '?' < 'A').
+//
+#define CMD_LIST \
+  CMD(SL,  "/",   cmd_qm,  "") \
+  CMD(SS,  "//",  cmd_qq,  "") \
+  CMD(QM,  "?",   cmd_qm,  "val\tprint 8 bit value (calculator), alias: /") \
+  CMD(QQ,  "??",  cmd_qq,  "word\tprint 16 bit value (calculator), alias: //") \
+  CMD(A,   "A",   cmd_a,   "\tMonitor analog inputs **") \
+  CMD(AC,  "AC",  cmd_ac,  "mux cs\tAIN0 vs AIN1/MUX edge capture (Timer1 clk select cs)") \
+  CMD(ACB, "ACB", cmd_acb, "mux cs\tAC with the bandgap as positive input") \
+  CMD(AF,  "AF",  cmd_af,  "mux para\tFFT of 2^para (6-8) ADC samples of MUX") \
+  CMD(AFN, "AFN", cmd_afn, "val\tFFT top bins to print (5)") \
+  CMD(AP,  "AP",  cmd_ap,  "para\tSet analog prescaler 1-7, ?") \
+  CMD(AR,  "AR",  cmd_ar,  "para\tSet analog reference 0, 1, 3, ?") \
+  CMD(AX,  "AX",  cmd_ax,  "\tAnalog input off") \
+  CMD(B,   "B",   cmd_b,   "[pin mode]\tToggle BIT (output) / triggered read (input) / set BIT pin=" QS(LED_PIN) " mode=OH/OL/IH/IL, ?, P") \
+  CMD(BA,  "BA",  cmd_ba,  "word val\tBounce histograms of word BIT events (14), quiet val ms (A) **") \
+  CMD(BB,  "BB",  cmd_bb,  "word\tBlink BIT (unit 100 ms) (O) **") \
+  CMD(BD,  "BD",  cmd_bd,  "\tDump recorded data") \
+  CMD(BG,  "BG",  cmd_bg,  "word\tSquare wave of BIT at word Hz in background") \
+  CMD(BGK, "BGK", cmd_bgk, "word\tSquare wave of BIT at word kHz in background") \
+  CMD(BH,  "BH",  cmd_bh,  "\tBIT to 1 (high)") \
+  CMD(BL,  "BL",  cmd_bl,  "\tBIT to 0 (low)") \
+  CMD(BP,  "BP",  cmd_bp,  "[P]\tRecord pins around BIT pin (w/ P, print recorded data)") \
+  CMD(BPG, "BPG", cmd_bpg, "word [L]\tReplay recorded pins to BIT port at word Hz (L: loop)") \
+  CMD(BPU, "BPU", cmd_bpu, "word\tUpload word bytes of binary pattern for BPG") \
+  CMD(BPX, "BPX", cmd_bpx, "\tStop pattern replay") \
+  CMD(BTS, "BTS", cmd_bts, "tspan tcount\tSet time span and trigger count") \
+  CMD(BTU, "BTU", cmd_btu, "word\tSet unit in ms (1)") \
+  CMD(BW,  "BW",  cmd_bw,  "duty word\tPWM of BIT duty/100 at word Hz (80 3E8) in background") \
+  CMD(BWX, "BWX", cmd_bwx, "\tStop PWM / square wave") \
+  CMD(BX,  "BX",  cmd_bx,  "[color]\tSend LED data / set FFFFFF-like or .R.G.B-like series, ?: print") \
+  CMD(BXA, "BXA", cmd_bxa, "val\tPlay built-in LED animation at val FPS (1E) **") \
+  CMD(BXH, "BXH", cmd_bxh, "val\tLED data by BIT pin (0) or " PIX_PINS " in background (1)") \
+  CMD(BXN, "BXN", cmd_bxn, "word\tSet word LEDs repeating the LED data") \
+  CMD(BXS, "BXS", cmd_bxs, "word val\tShow word frames streamed in binary at val FPS (1E)") \
+  CMD(CE,  "CE",  cmd_ce,  "\tErase the saved configuration") \
+  CMD(CL,  "CL",  cmd_cl,  "\tLoad the saved configuration") \
+  CMD(CS,  "CS",  cmd_cs,  "val\tSave MASK, I/O, BIT pin, timing, ADC, LEDs for reset, val=1: quiet reset") \
+  CMD(D,   "D",   cmd_d,   "\tPIN state") \
+  CMD(DC,  "DC",  cmd_dc,  "\tPIN state (changed **)") \
+  CMD(FM,  "FM",  cmd_fm,  "\tFrequency, period, duty and jitter of " FREQ_PINS " **") \
+  CMD(GC,  "GC",  cmd_gc,  "val\tCount glitches < val us (A) on active INPUT of PCINT ports in background") \
+  CMD(GS,  "GS",  cmd_gs,  "\tGlitch counter status") \
+  CMD(GX,  "GX",  cmd_gx,  "\tStop the glitch counter") \
+  CMD(H,   "H",   cmd_h,   "\tThis help") \
+  CMD(IA,  "IA",  cmd_ia,  "val\tI2C device address (50)") \
+  CMD(IC,  "IC",  cmd_ic,  "word\tI2C clock in kHz (64, max 190)") \
+  CMD(IR,  "IR",  cmd_ir,  "reg word\tI2C read word bytes (10) from reg") \
+  CMD(IS,  "IS",  cmd_is,  "\tI2C bus scan") \
+  CMD(IW,  "IW",  cmd_iw,  "reg data\tI2C write FFFF-like data from reg") \
+  CMD(LC,  "LC",  cmd_lc,  "mode val word\tArm power-up logger 1: BIT port pins, 2: BIT edges, 3: ADC val every word ms") \
+  CMD(LD,  "LD",  cmd_ld,  "\tDump the EEPROM log") \
+  CMD(LE,  "LE",  cmd_le,  "\tErase the EEPROM log") \
+  CMD(LS,  "LS",  cmd_ls,  "\tRun the armed logger now **") \
+  CMD(MD,  "MD",  cmd_md,  "name; cmd; ...\tDefine macro name as the rest of the line (none: delete)") \
+  CMD(ML,  "ML",  cmd_ml,  "\tList macros") \
+  CMD(MR,  "MR",  cmd_mr,  "name word word\tRun macro word times (1, 0: **), word ms apart, print time") \
+  CMD(NI,  "NI",  cmd_ni,  "\tSniff I2C on " TWI_PINS " (100 kHz) **") \
+  CMD(NS,  "NS",  cmd_ns,  "val\tSniff SPI MOSI in mode val (0) on " SPI_PINS " **") \
+  CMD(NU,  "NU",  cmd_nu,  "word\tSniff UART RX on BIT pin at word baud (2580) **") \
+  CMD(PC,  "PC",  cmd_pc,  "pin\tSPI CS pin (SS)") \
+  CMD(PD,  "PD",  cmd_pd,  "val\tSPI clock divider 2-80 (4)") \
+  CMD(PM,  "PM",  cmd_pm,  "val\tSPI mode (0)") \
+  CMD(PS,  "PS",  cmd_ps,  "word val\tSample MOSI at word kHz (A6A) by SPI slave, val=1: on edge") \
+  CMD(PX,  "PX",  cmd_px,  "data word\tSPI send FFFF-like data, then word 0xFF bytes, print received") \
+  CMD(R,   "R",   cmd_r,   "addr0 addr1\tsram hexdump") \
+  CMD(RA,  "RA",  cmd_ra,  "addr0 addr1\tsram alldump") \
+  CMD(RE,  "RE",  cmd_nop, "") \
+  CMD(RP,  "RP",  cmd_rp,  "addr0 addr1\tprogram hexdump") \
+  CMD(S,   "S",   cmd_s,   "\tSet initial") \
+  CMD(SC,  "SC",  cmd_sc,  "word\tContinuity scan of active OUTPUT to pins, repeated word times (1)") \
+  CMD(SIH, "SIH", cmd_sip, "") \
+  CMD(SIL, "SIL", cmd_sit, "") \
+  CMD(SIP, "SIP", cmd_sip, "\tSet INPUT pull-up, alias: SIH") \
+  CMD(SIT, "SIT", cmd_sit, "\tSet INPUT tri-state, alias: SIL") \
+  CMD(SK,  "SK",  cmd_sk,  "\tSet alternative") \
+  CMD(SKB, "SKB", cmd_skb, "val\tKey matrix scan benchmark (rows: OUTPUT, settle val us) **") \
+  CMD(SM,  "SM",  cmd_sm,  "\tSet MASK") \
+  CMD(SMD, "SMD", cmd_smd, "\tSet mask disabled for display") \
+  CMD(SME, "SME", cmd_sme, "\tSet mask enabled for display") \
+  CMD(SOH, "SOH", cmd_soh, "\tSet OUTPUT 1") \
+  CMD(SOL, "SOL", cmd_sol, "\tSet OUTPUT 0") \
+  CMD(SPD, "SPD", cmd_spd, "\tSet MCUCR PUD to disable pull-up") \
+  CMD(SPE, "SPE", cmd_spe, "\tClear MCUCR PUD to enable pull-up") \
+  CMD(TA,  "TA",  cmd_ta,  "val word\tTask: print ADC val every word ms (3E8)") \
+  CMD(TB,  "TB",  cmd_tb,  "word\tTask: blink the BIT pin every word ms (1F4)") \
+  CMD(TL,  "TL",  cmd_tl,  "\tList tasks and CPU share since the last TL") \
+  CMD(TM,  "TM",  cmd_tm,  "word\tTask: print changes of active INPUT pins, poll every word ms (A)") \
+  CMD(TP,  "TP",  cmd_tp,  "val word\tTask: PWM the BIT pin val/100 (80) in a word ms cycle (14)") \
+  CMD(TX,  "TX",  cmd_tx,  "val\tStop task val (all)") \
+  CMD(W,   "W",   cmd_w,   "addr val ...\tsram =write") \
+  CMD(WA,  "WA",  cmd_wa,  "addr val ...\tsram &=write") \
+  CMD(WE,  "WE",  cmd_nop, "") \
+  CMD(WO,  "WO",  cmd_wo,  "addr val ...\tsram |=write") \
+  CMD(WP,  "WP",  cmd_nop, "")
+
+typedef struct {
+  char name[4];                     // command name (upper case)
+  void (*fn)(uint8_t argc, char **argv);   // handler
+#ifdef VERBOSE
+  PGM_P help;                       // "args\thelp" for H
+#endif
+} cmd_t;
+
+#ifdef VERBOSE
+#define CMD(id, name, fn, help) static const char cmd_help_##id[] PROGMEM = help;
+CMD_LIST
+#undef CMD
+#define CMD(id, name, fn, help) {name, fn, cmd_help_##id},
+#else
+#define CMD(id, name, fn, help) {name, fn},
+#endif
+static const cmd_t cmd_table[] PROGMEM = {CMD_LIST};
+#undef CMD
+#define N_CMD (sizeof(cmd_table) / sizeof(cmd_t))
+
+// binary search, return N_CMD if not found
+static uint8_t cmd_find(char *name) {
+  uint8_t lo = 0, hi = N_CMD, m;
+  int c;
+  while (lo < hi) {
+    m = (lo + hi) / 2;
+    c = strcmp_P(name, cmd_table[m].name);
+    if (c == 0) return m;
+    if (c < 0) {
+      hi = m;
+    } else {
+      lo = m + 1;
+    }
+  }
+  return N_CMD;
+}
+
+static void cmd_exec(uint8_t argc, char **argv) {
+  uint8_t i = cmd_find(argv[0]);
+  void (*fn)(uint8_t, char **);
+  if (i < N_CMD) {
+    fn = (void (*)(uint8_t, char **))pgm_read_word(&cmd_table[i].fn);
+    fn(argc, argv);
+    return;
+  }
+  print_sP(PSTR("Unexpected input tokens: "));
+  for (i = 0; i < argc; i++) {
+    if (i) print_sP(PSTR(", "));
+    print_c('"');
+    print_s(argv[i]);
+    print_c('"');
+  }
+  print_crlf();
+}
+
+//
+// Command line: split in place (zero copy) and run command by command
+//
+// ' ' separates arguments, ';' separates commands.  Separators are
+// overwritten by '\0' while the ';' positions are kept in line_semi[], so
+// line_restore() can give the last line back for the history.  A command
+// may take the rest of the line (line_rest) and set line_stop (MD).
+//
+#define ARGS_MAX 16  // argv[1] ... argv[ARGS_MAX - 1]
+static uint8_t line_semi[(BUFSIZE + 7) / 8];  // ';' positions (bitmap)
+static uint8_t line_len;                       // length of the last line
+static char *line_rest;                        // rest after the command
+static uint8_t line_stop;                      // rest taken by the command
+
+static void line_restore(char *s) {
+  uint8_t i;
+  for (i = 0; i < line_len; i++) {
+    if (s[i] == '\0') {
+      s[i] = (line_semi[i >> 3] & _BV(i & 7)) ? ';' : ' ';
+    }
+  }
+}
+
+// record ';' in semi[] (if not NULL), return the length to restore
+static uint8_t line_run(char *s, uint8_t *semi) {
+  char *argv[ARGS_MAX + 1];
+  uint8_t argc = 0, i, j;
+  char c;
+  if (semi != NULL) memset(semi, 0, (BUFSIZE + 7) / 8);
+  for (i = 0; ; i++) {
+    c = s[i];
+    if (c == ' ' || c == ';' || c == '\0') {
+      if (c == ';' && semi != NULL) semi[i >> 3] |= _BV(i & 7);
+      s[i] = '\0';
+      if (c != ' ' && argc > ARGS_MAX) {
+        argc = 0;  // not run (error printed)
+      } else if (c != ' ' && argc) {
+        for (j = argc; j <= ARGS_MAX; j++) argv[j] = NULL;
+        line_rest = (c == ';') ? s + i + 1 : s + i;
+        cmd_exec(argc, argv);
+        argc = 0;
+        if (line_stop) {
+          line_stop = 0;
+          return i + 1;
+        }
+      }
+      if (c == '\0') break;
+    } else if (i == 0 || s[i - 1] == '\0') {
+      if (argc < ARGS_MAX) {
+        argv[argc++] = s + i;  // token start
+      } else if (argc == ARGS_MAX) {
+        print_sP(PSTR("E: too many arguments, "));
+        print_s(argv[0]);
+        print_sP(PSTR(" skipped\n"));
+        argc++;
+      }
+    }
+  }
+  return i;
+}
+
+//
+// Macros: named command lines kept in SRAM and replayed on the MCU
+//
+// macro_buf[] = "NAME\0BODY\0NAME\0BODY\0\0" (packed).  A replay runs
+// a copy of the body, so the body can be run again as it is.  The time
+// is measured on TIMER1 (clk/64) unless a command of the macro used it.
+//
+static char macro_buf[MACRO_SIZE];  // zero: no macro
+static uint8_t macro_depth;         // replaying
+
+// return the entry of name, or the end of macro_buf[] if not found
+static char *macro_find(char *name) {
+  char *p = macro_buf;
+  while (*p != '\0') {
+    if (!strcmp(p, name)) break;
+    p += strlen(p) + 1;
+    p += strlen(p) + 1;
+  }
+  return p;
+}
+
+static char *macro_end(void) { return macro_find(""); }
+
+static void cmd_md(uint8_t argc, char **argv) {
+  char *p, *q, *body;
+  uint16_t n;
+  if (macro_depth || argv[1] == NULL) {
+    print_sP(PSTR("E: MD name; commands (not in a macro)\n"));
+    return;
+  }
+  body = line_rest;
+  line_stop = 1;  // the rest of the line is the body
+  while (*body == ' ' || *body == ';') body++;
+  p = macro_find(argv[1]);
+  if (*p != '\0') {
+    // delete the old definition
+    q = p + strlen(p) + 1;
+    q += strlen(q) + 1;
+    memmove(p, q, macro_buf + MACRO_SIZE - q);
+    memset(macro_buf + MACRO_SIZE - (q - p), 0, q - p);
+  }
+  if (*body == '\0') {
+    print_sP(PSTR("MACRO DELETED\n"));
+    return;
+  }
+  p = macro_end();
+  n = strlen(argv[1]) + strlen(body) + 2;
+  if (p + n >= macro_buf + MACRO_SIZE) {
+    print_sP(PSTR("E: no space for the macro\n"));
+    return;
+  }
+  strcpy(p, argv[1]);
+  strcpy(p + strlen(p) + 1, body);
+  print_sP(PSTR("MACRO "));
+  print_s(argv[1]);
+  print_sP(PSTR(" DEFINED\n"));
+}
+
+static void cmd_ml(uint8_t argc, char **argv) {
+  char *p = macro_buf;
+  while (*p != '\0') {
+    print_s(p);
+    print_sP(PSTR(": "));
+    p += strlen(p) + 1;
+    print_s(p);
+    print_crlf();
+    p += strlen(p) + 1;
+  }
+  print_sP(PSTR("MACRO FREE="));
+  print_hex4(macro_buf + MACRO_SIZE - 1 - macro_end());
+  print_sP(PSTR(" bytes\n"));
+}
+
+// MR name count ms: count runs (0: until a key is pressed), ms apart
+static void cmd_mr(uint8_t argc, char **argv) {
+  char b[BUFSIZE];
+  char *body;
+  uint16_t count = (argv[2] != NULL) ? str2word(argv[2]) : 1;
+  uint16_t ms = str2word(argv[3]);
+  uint16_t runs = 0, k;
+  uint8_t timed = 0, uses = 0;
+  uint8_t toie = TIMSK1 & _BV(TOIE1);
+  uint32_t dt = 0;
+  const uint8_t cs = _BV(CS11) | _BV(CS10);  // clk/64
+  if (macro_depth) {
+    print_sP(PSTR("E: macros do not nest\n"));
+    return;
+  }
+  body = (argv[1] != NULL) ? macro_find(argv[1]) : macro_end();
+  if (*body == '\0') {
+    print_sP(PSTR("E: no such macro\n"));
+    return;
+  }
+  body += strlen(body) + 1;
+  macro_depth = 1;
+  if (!(timer_busy & _BV(1)) && t1_start(cs)) {
+    timed = 1;
+    uses = t1_uses;
+  }
+  do {
+    if (runs) {
+      for (k = ms; k; k--) _delay_ms(1);
+    }
+    strcpy(b, body);
+    line_run(b, NULL);
+    runs++;
+    if (check_input()) break;
+  } while (count == 0 || runs < count);
+  if (timed) {
+    if (t1_uses == uses) {
+      // TIMER1 not used by the macro
+      dt = t1_time();
+      TCCR1B = 0;
+    } else {
+      timed = 0;
+    }
+    // TOIE1 as before MR, unless a t1_start() job of the macro runs on
+    if (t1_ovf_use == uses || !(timer_busy & _BV(1))) {
+      TIMSK1 = (TIMSK1 & ~_BV(TOIE1)) | toie;
+    }
+  }
+  macro_depth = 0;
+  print_sP(PSTR("MACRO "));
+  print_s(argv[1]);
+  print_sP(PSTR(" RUNS="));
+  print_hex4(runs);
+  if (timed) {
+    dt *= 64 / (F_CPU / 1000000UL);  // us
+    print_sP(PSTR(" TIME="));
+    print_dec(dt);
+    print_sP(PSTR(" us ("));
+    print_dec(dt / runs);
+    print_sP(PSTR(" us/run)"));
+  } else {
+    print_sP(PSTR(" (TIMER1 used, no time)"));
+  }
+  print_crlf();
+}
+
+#ifdef DEBUG_MON
+// the binary search needs cmd_table[] sorted
+static void cmd_check(void) {
+  uint8_t i;
+  for (i = 1; i < N_CMD; i++) {
+    if (strcmp_P(cmd_table[i - 1].name, cmd_table[i].name) >= 0) {
+      print_sP(PSTR("E: cmd_table[] not sorted at "));
+      print_sP(cmd_table[i].name);
+      print_crlf();
+    }
+  }
+}
+#endif // DEBUG_MON
+
+#ifdef VERBOSE
+// generated from cmd_table[]: name args, help
+static void cmd_h(uint8_t argc, char **argv) {
+  uint8_t i, n;
+  char c;
+  PGM_P p;
+  print_sP(PSTR("===== Command syntax =====\n"));
+  for (i = 0; i < N_CMD; i++) {
+    p = (PGM_P)pgm_read_word(&cmd_table[i].help);
+    if (pgm_read_byte(p) == '\0') continue;  // alias
+    print_sP(cmd_table[i].name);
+    n = strlen_P(cmd_table[i].name);
+    do {
+      print_c(' ');
+      n++;
+    } while (n < 4);
+    while ((c = pgm_read_byte(p++)) != '\t') {
+      print_c(c);
+      n++;
+    }
+    do {
+      print_c(' ');
+      n++;
+    } while (n < 16);
+    print_sP(p);
+    print_crlf();
+  }
+  print_sP(PSTR(
+"\n"
+"** runs until a key is pressed\n"
+"Numbers: hexadecimal / ~: bit flip, %....: binary, @...: mnemonic\n"
+"         '.' means sram next,  ',' means sram previous\n"
+"         '>' means flash next, '<' means flash previous\n"
+));
+}
+#else
+// command names only
+static void cmd_h(uint8_t argc, char **argv) {
+  uint8_t i;
+  for (i = 0; i < N_CMD; i++) {
+    print_sP(cmd_table[i].name);
+    print_c((i % 16 == 15) ? '\n' : ' ');
+  }
+  print_crlf();
+}
+#endif // VERBOSE
+///////////////////////////////////////////////////////////////////////////
+//
+// System monitor
+//
+/////////////////////////////////////////////////////////////////////////////
+int main(void) {
+  // command lines for main loop (w/ history): read into line[cur] while
+  // line[cur ^ 1] keeps the last line
+  char line[2][BUFSIZE];
+  uint8_t cur = 0;
+  char *s;
+  char *last;
+  cfg_t cfg; // saved configuration
+  uint8_t cfg_ok;
+  // sram pointer
+  addr_sram = 0x00;                 // start of SRAM
+  addr_sram_last = 0x00;            // start of SRAM (last)
+  // program memory hexdump pointer
+  addr_flash = 0x00;                // start flash
+  addr_flash_last = 0x00;           // start
+  // initialize MCU
+  CPU_PRESCALE;
+  // initialize USB
+  init_comm();
+  // interrupts are used only by background jobs (and USB)
+  sei();
+  // armed datalogger runs until the host connects
+  log_autostart();
+  wait_comm();
+  led_init(); // LED data buffer in free SRAM
+  strcpy(line[1], "D");  // initial safe value
+  last = line[1];
+  cfg_ok = cfg_read(&cfg);
+  if (cfg_ok && (cfg.flags & CFG_QUIET)) {
+    // quiet reset: saved configuration only, no banner
+    cfg_apply(&cfg);
+    if (log_ran) log_report(); // logged before the host connected
+  } else {
+    // opening messages
+    print_sP(PSTR("\nAVRmon v 0.2\n"));
+    print_sP(PSTR("  MCU   = " QS(MCU) "  F_CPU = " QS(F_CPU) "\n"));
+    print_sP(PSTR("  BOARD = " QS(BOARD) "     BAUD = " QS(BAUD) "\n"));
+    print_sP(PSTR("  GPL 2.0+, Copyright 2020 - 2021, <osamu@debian.org>\n\n"));
+    print_sP(PSTR("Commands are case insensitive.  'H' for more help.\n"));
+    print_sP(PSTR("Numbers are typed as binary or hexadecimal: %11110100 == ~%0001011 == F4 == ~0B\n"));
+    if (log_ran) log_report(); // logged before the host connected
+    // initialize bit operation
+    initialize_ddr_in(); // set up default ddr (input)
+    initialize_mask(); // set up default mask
+    mask_enabled_for_display(); // enable mask for display
+    input_pullup(); // Enable pull-up for input
+    ledlen = bit_pixel_set(".P", pixled);  // pre-set value for pixel
+    bit_pixel_dump(ledlen, pixled); // display pixel preset values
+    adps_set("7"); // ADC prescaler 1/128
+    aref_set("1"); // VREF=Vcc
+#ifdef DEBUG_MON
+    cmd_check(); // command table order
+#endif // DEBUG_MON
+    if (cfg_ok) {
+      cfg_apply(&cfg);
+      print_sP(PSTR("CONFIG LOADED"));
+      cfg_report(&cfg);
+    }
+    print_crlf(); // end of initialization
+    // display mcu states
+    display_digital();
+  }
+  // main infinite loop
   while (1) {
+    s = line[cur];
     s[0] = '\0';  // clear line
     print_sP(PSTR("command > "));
     read_line(s);
-    str_main = s;
-    while (*str_main == ' ' || *str_main == ';') {
-      str_main++;
+    while (*s == ' ' || *s == ';') {
+      s++;
     }  // drop leading ' ' and ';'
-    if (*str_main != '\0') {
-      strcpy(sx, str_main);  // if not return, keep this as the last line
+    if (*s != '\0') {
+      last = s;  // if not return, keep this as the last line
+      cur ^= 1;
     } else {
-      strcpy(s, sx);  // if return, restore the last line
+      s = last;  // if return, restore the last line
+      line_restore(s);
       print_sP(PSTR("\e[Acommand > "));
       print_s(s);
       print_crlf();
     }
-    while (1) {
-      // tokenize (if zero length, make it NULL)
-      token_main = strtok_r(str_main, ";", &saveptr_main);
-      if (token_main == NULL || *token_main == '\0') break;  // next line
-      str_sub = token_main;
-      token_sub1 = strtok_r(str_sub, " ", &saveptr_sub);
-      if (token_sub1 == NULL || *token_sub1 == '\0') {
-        break;  // next line
-      } else {
-        str_sub = NULL;
-        token_sub2 = strtok_r(str_sub, " ", &saveptr_sub);
-        if (token_sub2 == NULL) {
-          token_sub3 = NULL;
-        } else if (*token_sub2 == '\0') {
-          token_sub3 = token_sub2 = NULL;
-        } else {
-          token_sub3 = strtok_r(str_sub, " ", &saveptr_sub);
-          if (*token_sub3 == '\0') token_sub3 = NULL;
-        }
-        //
-        // process tokens
-        //
-        if (!strcmp_P(token_sub1, PSTR("R"))) {
-          // read from SRAM (hexdump) progressive location
-          if (token_sub2 != NULL) {
-            addr_sram_tmp = addr_sram;
-            addr_sram = str2word(token_sub2);
-            addr_sram_last = addr_sram_tmp;
-          }
-          if (addr_sram > MAX_SRAM) addr_sram = MAX_SRAM;
-          if (token_sub3 != NULL) {
-            addr_sram_end = str2word(token_sub3);
-          } else {
-            addr_sram_end = addr_sram + addr_sram_range;
-          }
-          if (addr_sram_end > MAX_SRAM) addr_sram_end = MAX_SRAM;
-          if (addr_sram_end < addr_sram) addr_sram_end = addr_sram;
-          //
-          print_hexdump(addr_sram, addr_sram_end, &read_sram);
-          //
-          addr_sram_range = addr_sram_end - addr_sram;
-          addr_sram = addr_sram_end + 1;
-          if (addr_sram > MAX_SRAM) addr_sram = 0;
-          addr_sram_end = addr_sram + addr_sram_range;
-          if (addr_sram_end > MAX_SRAM) addr_sram_end = MAX_SRAM;
-        } else if (!strcmp_P(token_sub1, PSTR("RA"))) {
-          // read from SRAM (alldump) progressive location
-          if (token_sub2 != NULL) {
-            addr_sram_tmp = addr_sram;
-            addr_sram = str2word(token_sub2);
-            addr_sram_last = addr_sram_tmp;
-          }
-          if (addr_sram > MAX_SRAM) addr_sram = MAX_SRAM;
-          if (token_sub3 != NULL) {
-            addr_sram_end = str2word(token_sub3);
-          } else {
-            addr_sram_end = addr_sram + addr_sram_range;
-          }
-          if (addr_sram_end > MAX_SRAM) addr_sram_end = MAX_SRAM;
-          if (addr_sram_end < addr_sram) addr_sram_end = addr_sram;
-          //
-          print_alldump(addr_sram, addr_sram_end, &read_sram);
-          //
-          addr_sram_range = addr_sram_end - addr_sram;
-          addr_sram = addr_sram_end + 1;
-          if (addr_sram > MAX_SRAM) addr_sram = 0;
-          addr_sram_end = addr_sram + addr_sram_range;
-          if (addr_sram_end > MAX_SRAM) addr_sram_end = MAX_SRAM;
-        } else if (!strcmp_P(token_sub1, PSTR("RP"))) {
-          // read from program memory (hexdump) progressive location
-          if (token_sub2 != NULL) {
-            addr_flash_tmp = addr_flash;
-            addr_flash = str2word(token_sub2);
-            addr_flash_last = addr_flash_tmp;
-          }
-          if (addr_flash > MAX_FLASH) addr_flash = MAX_FLASH;
-          if (token_sub3 != NULL) {
-            addr_flash_end = str2word(token_sub3);
-          } else {
-            addr_flash_end = addr_flash + addr_flash_range;
-          }
-          if (addr_flash_end > MAX_FLASH) addr_flash_end = MAX_FLASH;
-          if (addr_flash_end < addr_flash) addr_flash_end = addr_flash;
-          //
-          print_hexdump(addr_flash, addr_flash_end, &read_flash);
-          //
-          addr_flash_range = addr_flash_end - addr_flash;
-          addr_flash = addr_flash_end + 1;
-          if (addr_flash > MAX_FLASH) addr_flash = 0;
-          addr_flash_end = addr_flash + addr_flash_range;
-          if (addr_flash_end > MAX_FLASH) addr_flash_end = MAX_FLASH;
-        } else if (!strcmp_P(token_sub1, PSTR("RE"))) {
-          // XXX FIXME XXX
-        //
-        ///////////////////////////////////////////////////////////////
-        //
-        } else if (!strcmp_P(token_sub1, PSTR("W"))) {
-          // write to SRAM (alldump) progressive location
-          if (token_sub2 != NULL) {
-            addr_sram_tmp = addr_sram;
-            addr_sram = str2word(token_sub2);
-            addr_sram_last = addr_sram_tmp;
-          }
-          if (token_sub3 != NULL) val = str2byte(token_sub3);
-          if (addr_sram < MIN_SRAM) break;  // ignore
-          if (addr_sram > MAX_SRAM) break;  // ignore
-          write_sram(addr_sram, val);
-          print_alldump(addr_sram, addr_sram, &read_sram);
-          addr_sram++;
-          if (addr_sram > MAX_SRAM) addr_sram = MIN_SRAM;
-          print_alldump(addr_sram, addr_sram, &read_sram);
-        } else if (!strcmp_P(token_sub1, PSTR("WA"))) {
-          // write to SRAM (alldump) progressive location
-          if (token_sub2 != NULL) {
-            addr_sram_tmp = addr_sram;
-            addr_sram = str2word(token_sub2);
-            addr_sram_last = addr_sram_tmp;
-          }
-          if (token_sub3 != NULL) val = str2byte(token_sub3);
-          if (addr_sram < MIN_SRAM) break;  // ignore
-          if (addr_sram > MAX_SRAM) break;  // ignore
-          write_and_sram(addr_sram, val);
-          print_alldump(addr_sram, addr_sram, &read_sram);
-          addr_sram++;
-          if (addr_sram > MAX_SRAM) addr_sram = MIN_SRAM;
-          print_alldump(addr_sram, addr_sram, &read_sram);
-        } else if (!strcmp_P(token_sub1, PSTR("WO"))) {
-          // write to SRAM (alldump) progressive location
-          if (token_sub2 != NULL) {
-            addr_sram_tmp = addr_sram;
-            addr_sram = str2word(token_sub2);
-            addr_sram_last = addr_sram_tmp;
-          }
-          if (token_sub3 != NULL) val = str2byte(token_sub3);
-          if (addr_sram < MIN_SRAM) break;  // ignore
-          if (addr_sram > MAX_SRAM) break;  // ignore
-          write_or_sram(addr_sram, val);
-          print_alldump(addr_sram, addr_sram, &read_sram);
-          addr_sram++;
-          if (addr_sram > MAX_SRAM) addr_sram = MIN_SRAM;
-          print_alldump(addr_sram, addr_sram, &read_sram);
-        } else if (!strcmp_P(token_sub1, PSTR("WP"))) {
-          // XXX FIXME XXX
-        } else if (!strcmp_P(token_sub1, PSTR("WE"))) {
-          // XXX FIXME XXX
-        //
-        ///////////////////////////////////////////////////////////////
-        //
-#ifdef VERBOSE
-        } else if (!strcmp_P(token_sub1, PSTR("H"))) {
-          display_help();
-        //
-#endif // VERBOSE
-        ///////////////////////////////////////////////////////////////
-        //
-        } else if (!strcmp_P(token_sub1, PSTR("D"))) {
-          // display mcu states
-          display_digital();
-        } else if (!strcmp_P(token_sub1, PSTR("DC"))) {
-          monitor_digital();
-        //
-        ///////////////////////////////////////////////////////////////
-        //
-        // For switching between:
-        // * Tri-state ({DDxn, PORTxn} = 0b00)
-        // * Output high ({DDxn, PORTxn} = 0b11)
-        // We must step through:
-        // * Pull-up enabled {DDxn, PORTxn} = 0b01)
-        // * Output low ({DDxn, PORTxn} = 0b10)
-        //
-        // For switching between:
-        // * Pull-up enabled {DDxn, PORTxn} = 0b01)
-        // * Output low ({DDxn, PORTxn} = 0b10)
-        // We must step through:
-        // * Tri-state ({DDxn, PORTxn} = 0b00)
-        // * Output high ({DDxn, PORTxn} = 0b11)
-        //
-        // Set PUD bit in MCUCR to disable pull-up
-        //
-        } else if (!strcmp_P(token_sub1, PSTR("S"))) {
-          output_low();
-          input_tristate();
-          initialize_ddr_in();
-          initialize_mask();
-          display_digital();
-        } else if (!strcmp_P(token_sub1, PSTR("SK"))) {
-          output_low();
-          input_tristate();
-          initialize_ddr_inout();
-          initialize_mask();
-          display_digital();
-        } else if (!strcmp_P(token_sub1, PSTR("SM"))) {
-          mask_set();
-          display_digital();
-        } else if (!strcmp_P(token_sub1, PSTR("SMD"))) {
-          mask_disabled_for_display();
-        } else if (!strcmp_P(token_sub1, PSTR("SME"))) {
-          mask_enabled_for_display();
-        } else if (!strcmp_P(token_sub1, PSTR("SOH"))) {
-          output_high();
-        } else if (!strcmp_P(token_sub1, PSTR("SOL"))) {
-          output_low();
-        } else if ((!strcmp_P(token_sub1, PSTR("SIP"))) ||
-                  (!strcmp_P(token_sub1, PSTR("SIH")))) {
-          input_pullup();
-        } else if ((!strcmp_P(token_sub1, PSTR("SIT"))) ||
-                  (!strcmp_P(token_sub1, PSTR("SIL")))) {
-          input_tristate();
-        } else if (!strcmp_P(token_sub1, PSTR("SPD"))) {
-          set_pud();
-        } else if (!strcmp_P(token_sub1, PSTR("SPE"))) {
-          reset_pud();
-        //
-        ///////////////////////////////////////////////////////////////
-        //
-        } else if (!strcmp_P(token_sub1, PSTR("B"))) {
-          if (token_sub2 == NULL) {
-            if (_SFR_MEM8(addr_ddr) & _BV(addr_bit)) {
-              bit_toggle(); // output
-              display_digital();
-            } else {
-              bit_record(); // input
-              data_dump(); // input
-            }
-          } else {
-            bit_pin(token_sub2, token_sub3);
-          }
-        } else if (!strcmp_P(token_sub1, PSTR("BL"))) {
-          bit_off();
-          display_digital();
-        } else if (!strcmp_P(token_sub1, PSTR("BH"))) {
-          bit_on();
-          display_digital();
-        } else if (!strcmp_P(token_sub1, PSTR("BTU"))) {
-          if (token_sub2 == NULL) {
-            unit = 1; // 1 ms is minimum on normal AVR coding
-          } else {
-            unit = str2word(token_sub2);
-          }
-        } else if (!strcmp_P(token_sub1, PSTR("BTS"))) {
-          if (token_sub2 == NULL) {
-            tspan = 0x8000;
-            tcount = 5; // 5ms is typical switch delay
-          } else {
-            tspan = str2word(token_sub2);
-            if (token_sub3 == NULL) {
-              tcount = 5; // 5ms is typical switch delay
-            } else {
-              tcount = str2byte(token_sub3);
-            }
-          }
-        } else if (!strcmp_P(token_sub1, PSTR("BTX"))) {
-          if (token_sub2 == NULL) {
-            uunit1 = 5;
-            uunit3 = 15;
-          } else {
-            uunit1 = str2word(token_sub2);
-          }
-          if (token_sub3 == NULL) {
-            uunit3 = 3 * uunit1;
-          } else {
-            uunit3 = str2word(token_sub3);
-          }
-        } else if (!strcmp_P(token_sub1, PSTR("BP"))) {
-          if (token_sub2[0] != 'P') {
-            bit_record_pins();
-          }
-          data_dump();
-        } else if (!strcmp_P(token_sub1, PSTR("BB"))) {
-          bit_blink(str2word(token_sub2));
-          display_digital();
-        } else if (!strcmp_P(token_sub1, PSTR("BW"))) {
-          bit_wave(token_sub2);
-          display_digital();
-        } else if (!strcmp_P(token_sub1, PSTR("BX"))) {
-          if (token_sub2 == NULL || *token_sub2 == '\0') {
-            bit_pixel(ledlen, pixled);
-          } else if (token_sub2[0] == '?' || token_sub2[0] == '/') {
-            // NOP
-          } else {
-            ledlen = bit_pixel_set(token_sub2, pixled);
-          }
-          bit_pixel_dump(ledlen, pixled);
-        //
-        ///////////////////////////////////////////////////////////////
-        //
-        } else if (!strcmp_P(token_sub1, PSTR("AR"))) {
-          aref_set(token_sub2);
-        } else if (!strcmp_P(token_sub1, PSTR("AP"))) {
-          adps_set(token_sub2);
-        } else if (!strcmp_P(token_sub1, PSTR("A"))) {
-          monitor_analog();
-        } else if (!strcmp_P(token_sub1, PSTR("AX"))) {
-          analog_off();
-        //
-        ///////////////////////////////////////////////////////////////
-        //
-        } else if (!strcmp_P(token_sub1, PSTR("?")) ||
-                   !strcmp_P(token_sub1, PSTR("/")) ) {
-          print_sP(PSTR("byte -> bin / hex / ~hex / ascii >> "));
-          print_byte(str2byte(token_sub2), 0xff);
-          print_ascii(str2byte(token_sub2));
-          print_crlf();
-        } else if (!strcmp_P(token_sub1, PSTR("??")) ||
-                   !strcmp_P(token_sub1, PSTR("//")) ) {
-          print_sP(PSTR("word -> hex / ~hex >> "));
-          print_hex4(str2word(token_sub2));
-          print_sP(PSTR(" = ~"));
-          print_hex4(~str2word(token_sub2));
-          print_crlf();
-        } else {
-          print_sP(PSTR("Unexpected input tokens: "));
-          print_c('"');
-          print_s(token_sub1);
-          print_c('"');
-          print_c(',');
-          print_c(' ');
-          print_c('"');
-          print_s(token_sub2);
-          print_c('"');
-          print_c(',');
-          print_c(' ');
-          print_c('"');
-          print_s(token_sub3);
-          print_c('"');
-          print_crlf();
-        }
-        str_main = NULL; // to read next
-      }
-    }
+    line_len = line_run(s, line_semi);
   }
   print_sP(PSTR("\n!!! NEVER HERE !!! DEAD !!!\n"));
 }
@@ -36,11 +36,31 @@ void init_comm(void) {
   PORTB = PORTC = PORTD = 0xff;
 #endif
 #ifdef IO_USB
-  // initialize the USB, and then wait for the host
-  // to set configuration.  If the Teensy is powered
-  // without a PC connected to the USB port, this
-  // will wait forever.
+  // initialize the USB (the host is waited for by wait_comm)
   usb_init();
+#endif
+}
+
+//
+// Host present: USB configured with DTR set / a character received
+//
+uint8_t comm_ready(void) {
+#ifdef IO_SERIAL
+  return UCSR0A & _BV(RXC0);
+#endif
+#ifdef IO_USB
+  return usb_configured() && (usb_serial_get_control() & USB_SERIAL_DTR);
+#endif
+}
+
+//
+// Wait for the host
+//
+void wait_comm(void) {
+#ifdef IO_USB
+  // wait for the host to set configuration.  If the
+  // Teensy is powered without a PC connected to the
+  // USB port, this will wait forever.
   do {
   } while (!usb_configured()); /* wait */
   // wait for the user to run their terminal emulator program
@@ -177,6 +197,19 @@ void print_hex4(uint16_t u) {
   print_hex2(u & 0xff);
 }
 
+//
+// Output uint32_t in decimal (no leading zeros)
+//
+void print_dec(uint32_t u) {
+  char buf[10];
+  uint8_t i = 0;
+  do {
+    buf[i++] = '0' + (u % 10);
+    u /= 10;
+  } while (u != 0);
+  while (i > 0) print_c(buf[--i]);
+}
+
 // Check if input data exists
 //   USART Control and Status Register A
 //   Bit 7 – RXC0: USART Receive Complete
@@ -196,12 +229,16 @@ uint8_t check_input(void) {
 //
 // Character input
 //
+// input_idle (if set) is called while waiting (background tasks)
+void (*input_idle)(void);
+
 char input_char(void) {
   char c;
 #ifdef IO_SERIAL
   // loop until  RXC0 bit is set in UCSR0A
-  do {
-  } while (!(UCSR0A & _BV(RXC0)));
+  while (!(UCSR0A & _BV(RXC0))) {
+    if (input_idle) input_idle();
+  }
   if (UCSR0A & (_BV(FE0) | _BV(DOR0))) {
     // ERR | EOF --> treat as \n
     // Bit 4 - FE0: Frame Error
@@ -220,6 +257,7 @@ char input_char(void) {
       break;
     }
     // loop until you get serial input
+    if (input_idle) input_idle();
   }
   if (cc <= 0 ) {
     print_sP(PSTR("\nE: Oops, non-valid negative key code hex="));
@@ -234,6 +272,45 @@ char input_char(void) {
   return c;
 }
 
+//
+// Raw byte input (binary data, no translation)
+//
+uint8_t input_raw(void) {
+  uint8_t c;
+#ifdef IO_SERIAL
+  do {
+  } while (!(UCSR0A & _BV(RXC0)));
+  c = UDR0;
+#endif
+#ifdef IO_USB
+  int16_t cc;
+  do {
+    cc = usb_serial_getchar();
+  } while (cc == -1);
+  c = cc & 0xff;
+#endif
+  return c;
+}
+
+//
+// Raw byte input with a timeout: -1 after ms without a byte
+//
+int16_t input_raw_ms(uint16_t ms) {
+  uint8_t k;
+  do {
+    for (k = 100; k; k--) {
+#ifdef IO_SERIAL
+      if (UCSR0A & _BV(RXC0)) return input_raw();
+#endif
+#ifdef IO_USB
+      if (usb_serial_available()) return input_raw();
+#endif
+      _delay_us(10);
+    }
+  } while (--ms);
+  return -1;
+}
+
 //
 // String input with TAB/BS/^W/^U support
 //
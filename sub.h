@@ -6,6 +6,8 @@
 #include <avr/pgmspace.h>
 
 void init_comm(void) ;
+uint8_t comm_ready(void);
+void wait_comm(void);
 void print_c(char c);
 void print_up(uint8_t n);
 void print_s(char *s);
@@ -17,8 +19,12 @@ void print_hex2(uint8_t u);
 void print_byte(uint8_t u, uint8_t m);
 void print_ascii(uint8_t u);
 void print_hex4(uint16_t u);
+void print_dec(uint32_t u);
 uint8_t check_input(void);
 char input_char(void);
+extern void (*input_idle)(void);
+uint8_t input_raw(void);
+int16_t input_raw_ms(uint16_t ms);
 void read_line(char *s);
 uint8_t str2byte(char *s);
 